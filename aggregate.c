@@ -0,0 +1,104 @@
+#include "fib.h"
+#include <limits.h>
+#include <stdio.h>
+
+/**
+ * Sets fn = F(n) and fn1 = F(n + 1), reduced mod modulus when one is given.
+ */
+static void fibonacci_pair(mpz_t fn, mpz_t fn1, long n, const mpz_t modulus, int verbose) {
+  if (modulus != NULL) {
+    calculate_fibonacci_pair_mod(fn, fn1, n, modulus);
+  } else {
+    calculate_fibonacci_pair(fn, fn1, n, verbose);
+  }
+}
+
+/**
+ * Sets result to sum_{i=0..n} (-1)^i F(i) = (-1)^n F(n - 1) - 1, with the empty sum for n < 0.
+ */
+static void alternating_prefix(mpz_t result, long n, const mpz_t modulus, int verbose) {
+  if (n <= 0) {
+    // F(-1) = 1 makes the identity vanish at n = 0 as well
+    mpz_set_ui(result, 0);
+    return;
+  }
+
+  mpz_t next;
+  mpz_init(next);
+  fibonacci_pair(result, next, n - 1, modulus, verbose);
+  if (n % 2 != 0) {
+    mpz_neg(result, result);
+  }
+  mpz_sub_ui(result, result, 1);
+  mpz_clear(next);
+}
+
+int fibonacci_aggregate(mpz_t result, AggregateKind kind, long a, long b, const mpz_t modulus,
+                        int verbose) {
+  if (a < 0 || a > b || b > LONG_MAX - 2) {
+    return -1;
+  }
+  if (modulus != NULL && mpz_sgn(modulus) <= 0) {
+    return -1;
+  }
+
+  mpz_t low, low_next, high, high_next;
+  mpz_init(low);
+  mpz_init(low_next);
+  mpz_init(high);
+  mpz_init(high_next);
+
+  switch (kind) {
+    case AGGREGATE_SUM:
+      // sum_{i=a..b} F(i) = F(b + 2) - F(a + 1)
+      if (verbose) {
+        fprintf(stderr, "Using sum identity F(%ld) - F(%ld)\n", b + 2, a + 1);
+      }
+      fibonacci_pair(high, high_next, b + 1, modulus, verbose);
+      fibonacci_pair(low, low_next, a, modulus, verbose);
+      mpz_sub(result, high_next, low_next);
+      break;
+
+    case AGGREGATE_SUM_SQUARES:
+      // sum_{i=a..b} F(i)^2 = F(b) F(b + 1) - F(a - 1) F(a)
+      if (verbose) {
+        fprintf(stderr, "Using sum of squares identity F(%ld) F(%ld) - F(%ld) F(%ld)\n", b, b + 1,
+                a - 1, a);
+      }
+      fibonacci_pair(high, high_next, b, modulus, verbose);
+      mpz_mul(result, high, high_next);
+      if (a > 0) {
+        fibonacci_pair(low, low_next, a - 1, modulus, verbose);
+        mpz_submul(result, low, low_next);
+      }
+      break;
+
+    case AGGREGATE_ALTERNATING:
+      // Difference of two alternating prefix sums
+      if (verbose) {
+        fprintf(stderr, "Using alternating sum identity (-1)^n F(n - 1) - 1 at n=%ld and n=%ld\n",
+                b, a - 1);
+      }
+      alternating_prefix(high, b, modulus, verbose);
+      alternating_prefix(low, a - 1, modulus, verbose);
+      mpz_sub(result, high, low);
+      break;
+
+    default:
+      mpz_clear(low);
+      mpz_clear(low_next);
+      mpz_clear(high);
+      mpz_clear(high_next);
+      return -1;
+  }
+
+  if (modulus != NULL) {
+    mpz_mod(result, result, modulus);
+  }
+
+  mpz_clear(low);
+  mpz_clear(low_next);
+  mpz_clear(high);
+  mpz_clear(high_next);
+  return 0;
+}
@@ -1,13 +1,17 @@
 #include "fib.h"
+#include "probes.h"
 #include <stdio.h>
 #include <stdlib.h>
 
 void calculate_fibonacci_iterative(mpz_t result, long n, int verbose) {
+  FIB_PROBE2(calc__start, "iter", n);
   if (n == 0) {
     mpz_set_ui(result, 0);
+    FIB_PROBE3(calc__done, "iter", n, (long) mpz_size(result));
     return;
   } else if (n == 1) {
     mpz_set_ui(result, 1);
+    FIB_PROBE3(calc__done, "iter", n, (long) mpz_size(result));
     return;
   }
 
@@ -16,34 +20,37 @@ void calculate_fibonacci_iterative(mpz_t result, long n, int verbose) {
   mpz_init_set_ui(b, 0);
   mpz_init(c);
 
+  progress_begin("iterative", "iterations", n, PROGRESS_QUADRATIC);
   long i = 0;
-  while (i < n) {
-    if (verbose && (i == 0 || (i > 0 && (i % 100 == 0 || i == n - 1)))) {
-      fprintf(stderr, "Calculating F(%ld)...\n", i);
-    }
-
+  while (i < n && !CALCULATION_CANCELLED()) {
     mpz_add(c, a, b);
     mpz_set(a, b);
     mpz_set(b, c);
     ++i;
+    PROGRESS_ADVANCE();
   }
+  progress_end();
 
   mpz_set(result, b);
 
   mpz_clear(a);
   mpz_clear(b);
   mpz_clear(c);
+  FIB_PROBE3(calc__done, "iter", n, (long) mpz_size(result));
 }
 
 void calculate_fibonacci_recursive(mpz_t result, long n, void *unused, int verbose) {
+  FIB_PROBE2(calc__start, "recur", n);
   (void) unused;  // Mark parameter as intentionally unused
 
   // Base cases
   if (n == 0) {
     mpz_set_ui(result, 0);
+    FIB_PROBE3(calc__done, "recur", n, (long) mpz_size(result));
     return;
   } else if (n == 1) {
     mpz_set_ui(result, 1);
+    FIB_PROBE3(calc__done, "recur", n, (long) mpz_size(result));
     return;
   }
 
@@ -54,16 +61,15 @@ void calculate_fibonacci_recursive(mpz_t result, long n, void *unused, int verbo
   mpz_init_set_ui(b, 1);  // F(1)
   mpz_init(temp);
 
-  for (long i = 2; i <= n; i++) {
-    if (verbose && (i % 100 == 0 || i <= 10)) {
-      fprintf(stderr, "Computing F(%ld) with optimized algorithm...\n", i);
-    }
-
+  progress_begin("recursive", "iterations", n - 1, PROGRESS_QUADRATIC);
+  for (long i = 2; i <= n && !CALCULATION_CANCELLED(); i++) {
     // F(i) = F(i-1) + F(i-2)
     mpz_add(temp, a, b);
     mpz_set(a, b);
     mpz_set(b, temp);
+    PROGRESS_ADVANCE();
   }
+  progress_end();
 
   // Set the result
   mpz_set(result, b);
@@ -72,14 +78,18 @@ void calculate_fibonacci_recursive(mpz_t result, long n, void *unused, int verbo
   mpz_clear(a);
   mpz_clear(b);
   mpz_clear(temp);
+  FIB_PROBE3(calc__done, "recur", n, (long) mpz_size(result));
 }
 
 void calculate_fibonacci_matrix(mpz_t result, long n, int verbose) {
+  FIB_PROBE2(calc__start, "matrix", n);
   if (n == 0) {
     mpz_set_ui(result, 0);
+    FIB_PROBE3(calc__done, "matrix", n, (long) mpz_size(result));
     return;
   } else if (n == 1) {
     mpz_set_ui(result, 1);
+    FIB_PROBE3(calc__done, "matrix", n, (long) mpz_size(result));
     return;
   }
 
@@ -99,7 +109,14 @@ void calculate_fibonacci_matrix(mpz_t result, long n, int verbose) {
   mpz_init(result21);
   mpz_init(result22);
 
+  // matrix_power advances once per squaring, one for each bit of n - 1 below the top one
+  long squarings = 0;
+  while ((n - 1) >> (squarings + 1) > 0) {
+    squarings++;
+  }
+  progress_begin("matrix", "squarings", squarings, PROGRESS_DOUBLING);
   matrix_power(a11, a12, a21, a22, n - 1, result11, result12, result21, result22, verbose);
+  progress_end();
 
   mpz_set(result, result11);
 
@@ -111,4 +128,130 @@ void calculate_fibonacci_matrix(mpz_t result, long n, int verbose) {
   mpz_clear(result12);
   mpz_clear(result21);
   mpz_clear(result22);
+  FIB_PROBE3(calc__done, "matrix", n, (long) mpz_size(result));
+}
+
+void calculate_fibonacci_pair(mpz_t fn, mpz_t fn1, long n, int verbose) {
+  FIB_PROBE2(calc__start, "pair", n);
+  mpz_t a11, a12, a21, a22;
+  mpz_init_set_ui(a11, 1);
+  mpz_init_set_ui(a12, 1);
+  mpz_init_set_ui(a21, 1);
+  mpz_init_set_ui(a22, 0);
+
+  mpz_t result11, result12, result21, result22;
+  mpz_init(result11);
+  mpz_init(result12);
+  mpz_init(result21);
+  mpz_init(result22);
+
+  // Q^n = [[F(n+1), F(n)], [F(n), F(n-1)]]
+  matrix_power(a11, a12, a21, a22, n, result11, result12, result21, result22, verbose);
+
+  mpz_set(fn, result12);
+  mpz_set(fn1, result11);
+
+  mpz_clear(a11);
+  mpz_clear(a12);
+  mpz_clear(a21);
+  mpz_clear(a22);
+  mpz_clear(result11);
+  mpz_clear(result12);
+  mpz_clear(result21);
+  mpz_clear(result22);
+  FIB_PROBE3(calc__done, "pair", n, (long) mpz_size(fn));
+}
+
+void calculate_fibonacci_pair_mod(mpz_t fn, mpz_t fn1, long n, const mpz_t modulus) {
+  FIB_PROBE2(calc__start, "pair-mod", n);
+  // Left-to-right square-and-multiply on Q^n with every entry reduced mod m
+  mpz_t r11, r12, r21, r22, c11, c12, c21, c22;
+  mpz_init_set_ui(r11, 1);
+  mpz_init_set_ui(r12, 0);
+  mpz_init_set_ui(r21, 0);
+  mpz_init_set_ui(r22, 1);
+  mpz_init(c11);
+  mpz_init(c12);
+  mpz_init(c21);
+  mpz_init(c22);
+
+  int bit = 0;
+  while (bit < (int) sizeof(long) * 8 - 1 && (n >> (bit + 1)) != 0) {
+    bit++;
+  }
+
+  for (; n > 0 && bit >= 0 && !CALCULATION_CANCELLED(); bit--) {
+    matrix_multiply(r11, r12, r21, r22, r11, r12, r21, r22, c11, c12, c21, c22);
+    if ((n >> bit) & 1) {
+      // Multiplying by Q shifts the columns: [[a + b, a], [c + d, c]]
+      mpz_add(r11, c11, c12);
+      mpz_set(r12, c11);
+      mpz_add(r21, c21, c22);
+      mpz_set(r22, c21);
+      mpz_swap(c11, r11);
+      mpz_swap(c12, r12);
+      mpz_swap(c21, r21);
+      mpz_swap(c22, r22);
+    }
+    mpz_mod(r11, c11, modulus);
+    mpz_mod(r12, c12, modulus);
+    mpz_mod(r21, c21, modulus);
+    mpz_mod(r22, c22, modulus);
+  }
+
+  mpz_mod(fn, r12, modulus);
+  mpz_mod(fn1, r11, modulus);
+
+  mpz_clear(r11);
+  mpz_clear(r12);
+  mpz_clear(r21);
+  mpz_clear(r22);
+  mpz_clear(c11);
+  mpz_clear(c12);
+  mpz_clear(c21);
+  mpz_clear(c22);
+  FIB_PROBE3(calc__done, "pair-mod", n, (long) mpz_size(fn));
+}
+
+void calculate_fibonacci_low_memory(mpz_t result, long n, int verbose) {
+  FIB_PROBE2(calc__start, "low-memory", n);
+  if (verbose) {
+    fprintf(stderr, "Using low-memory fast doubling\n");
+  }
+
+  // F(k) lives in result and F(k + 1) in fn1; one temporary replaces the matrix entries and
+  // the temporaries of matrix_power, and the squares are taken in place
+  mpz_t fn1, tmp;
+  mpz_init_set_ui(fn1, 1);
+  mpz_init(tmp);
+  mpz_set_ui(result, 0);
+
+  int bit = 0;
+  while (bit < (int) sizeof(long) * 8 - 1 && (n >> bit) > 1) {
+    bit++;
+  }
+  progress_begin("low-memory doubling", "steps", bit + 1, PROGRESS_DOUBLING);
+  for (; bit >= 0 && n > 0 && !CALCULATION_CANCELLED(); bit--) {
+    double span = trace_begin();
+    // F(2k) = F(k) (2 F(k + 1) - F(k)),  F(2k + 1) = F(k)^2 + F(k + 1)^2
+    mpz_mul_2exp(tmp, fn1, 1);
+    mpz_sub(tmp, tmp, result);
+    mpz_mul(tmp, tmp, result);
+    mpz_mul(result, result, result);
+    mpz_mul(fn1, fn1, fn1);
+    mpz_add(fn1, fn1, result);
+    mpz_swap(result, tmp);
+    if ((n >> bit) & 1) {
+      mpz_add(tmp, result, fn1);
+      mpz_swap(result, fn1);
+      mpz_swap(fn1, tmp);
+    }
+    trace_end("doubling_step", span, "k", n >> bit, "limbs", (long) mpz_size(fn1));
+    PROGRESS_ADVANCE();
+  }
+  progress_end();
+
+  mpz_clear(fn1);
+  mpz_clear(tmp);
+  FIB_PROBE3(calc__done, "low-memory", n, (long) mpz_size(result));
 }
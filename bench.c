@@ -0,0 +1,523 @@
+#ifdef __linux__
+#define _GNU_SOURCE  // sched_setaffinity, sched_getcpu
+#endif
+
+#include "fib.h"
+#include <errno.h>
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#ifdef __linux__
+#include <sched.h>
+#endif
+
+/**
+ * Micro-benchmarks of the engines, linked against the same objects as fib.
+ *
+ * Usage: fib-bench [options]
+ *   --min <n>            Smallest index of the grid (default: 1000)
+ *   --max <n>            Largest index of the grid (default: 1000000)
+ *   --points <k>         Log-spaced grid points between min and max (default: 7)
+ *   --linear-max <n>     Largest index for the iterative and recursive engines (default: 100000)
+ *   --reps <r>           Timed samples per benchmark (default: 101, so p99 is not the max)
+ *   --warmup <w>         Untimed runs before sampling (default: 2)
+ *   --cpu <id>           Pin to this CPU (default: the CPU the benchmark starts on)
+ *   --no-pin             Leave scheduling to the kernel
+ *   --json               Write JSON instead of CSV
+ *   -o <file>            Write results to file instead of stdout
+ *   --baseline <file>    Compare medians with an earlier CSV or JSON run
+ *   --threshold <pct>    Slowdown flagged as a regression (default: 10)
+ *
+ * A benchmark regresses when its median exceeds the baseline median by more than threshold
+ * percent and by more than BENCH_NOISE_IQRS baseline interquartile ranges, and reruns after
+ * the grid still do. A slowdown within the spread the baseline showed, or a burst of load
+ * that passed, is not flagged. Exits with status 1 on a regression.
+ */
+
+// Each timed sample repeats the operation until it runs at least this long, so fast cases are
+// not lost in clock resolution; the reported times are per call
+#define BENCH_MIN_SAMPLE_SECONDS 0.001
+
+#define BENCH_MAX_RESULTS 256
+
+// Times a suspected regression is re-timed before it is reported
+#define BENCH_CONFIRM_RUNS 2
+
+// Interquartile ranges of the baseline a median must move past before it counts as slower;
+// a median shift within that spread is the run-to-run noise the baseline itself showed
+#define BENCH_NOISE_IQRS 2.0
+
+typedef enum {
+  BENCH_ITERATIVE,
+  BENCH_RECURSIVE,
+  BENCH_MATRIX,
+  BENCH_LOW_MEMORY,
+  BENCH_MATRIX_MULTIPLY,
+  BENCH_FORMAT_DEC,
+  BENCH_FORMAT_HEX,
+  BENCH_FORMAT_BIN,
+  BENCHMARKS
+} Benchmark;
+
+static const char *const benchmark_names[BENCHMARKS] = {
+    "iterative",       "recursive",  "matrix",     "low_memory",
+    "matrix_multiply", "format_dec", "format_hex", "format_bin"};
+
+typedef struct {
+  Benchmark benchmark;
+  long n;
+  int reps;
+  long batch;  // calls per sample
+  double min;
+  double p25;
+  double median;
+  double p75;
+  double p95;
+  double p99;
+  double max;
+} BenchResult;
+
+// Operands shared by the conversion and multiplication benchmarks: F(n) and Q^n
+typedef struct {
+  mpz_t fn;
+  mpz_t q11, q12, q21, q22;
+  mpz_t c11, c12, c21, c22;
+} BenchOperands;
+
+static void run_once(Benchmark benchmark, long n, BenchOperands *operands, mpz_t scratch) {
+  switch (benchmark) {
+    case BENCH_ITERATIVE:
+      calculate_fibonacci_iterative(scratch, n, 0);
+      break;
+    case BENCH_RECURSIVE:
+      calculate_fibonacci_recursive(scratch, n, NULL, 0);
+      break;
+    case BENCH_MATRIX:
+      calculate_fibonacci_matrix(scratch, n, 0);
+      break;
+    case BENCH_LOW_MEMORY:
+      calculate_fibonacci_low_memory(scratch, n, 0);
+      break;
+    case BENCH_MATRIX_MULTIPLY:
+      matrix_multiply(operands->q11, operands->q12, operands->q21, operands->q22, operands->q11,
+                      operands->q12, operands->q21, operands->q22, operands->c11, operands->c12,
+                      operands->c21, operands->c22);
+      break;
+    case BENCH_FORMAT_DEC:
+    case BENCH_FORMAT_HEX:
+    case BENCH_FORMAT_BIN: {
+      OutputFormat format = benchmark == BENCH_FORMAT_DEC   ? DECIMAL
+                            : benchmark == BENCH_FORMAT_HEX ? HEXADECIMAL
+                                                            : BINARY;
+      free(get_formatted_result(operands->fn, format, 0));
+      break;
+    }
+    case BENCHMARKS:
+      break;
+  }
+}
+
+static int compare_doubles(const void *a, const void *b) {
+  double x = *(const double *) a;
+  double y = *(const double *) b;
+  return (x > y) - (x < y);
+}
+
+/**
+ * Nearest-rank percentile of sorted samples.
+ */
+static double percentile(const double *sorted, int count, double p) {
+  int rank = (int) ceil(p * count);
+  return sorted[rank > 0 ? rank - 1 : 0];
+}
+
+static void run_benchmark(BenchResult *out, Benchmark benchmark, long n, int reps, int warmup,
+                          BenchOperands *operands, double *samples) {
+  mpz_t scratch;
+  mpz_init(scratch);
+
+  // Warmup runs fault in memory and caches, and size the batch from the slowest of them
+  long batch = 1;
+  double slowest = 0.0;
+  for (int i = 0; i < warmup || i == 0; i++) {
+    double start = monotonic_seconds();
+    run_once(benchmark, n, operands, scratch);
+    double elapsed = monotonic_seconds() - start;
+    if (elapsed > slowest) {
+      slowest = elapsed;
+    }
+  }
+  if (slowest < BENCH_MIN_SAMPLE_SECONDS) {
+    batch = (long) (BENCH_MIN_SAMPLE_SECONDS / (slowest > 1e-9 ? slowest : 1e-9)) + 1;
+  }
+
+  for (int r = 0; r < reps; r++) {
+    double start = monotonic_seconds();
+    for (long b = 0; b < batch; b++) {
+      run_once(benchmark, n, operands, scratch);
+    }
+    samples[r] = (monotonic_seconds() - start) / (double) batch;
+  }
+  mpz_clear(scratch);
+
+  qsort(samples, (size_t) reps, sizeof(double), compare_doubles);
+  out->benchmark = benchmark;
+  out->n = n;
+  out->reps = reps;
+  out->batch = batch;
+  out->min = samples[0];
+  out->p25 = percentile(samples, reps, 0.25);
+  out->p75 = percentile(samples, reps, 0.75);
+  out->median = reps % 2 ? samples[reps / 2] : (samples[reps / 2 - 1] + samples[reps / 2]) / 2.0;
+  out->p95 = percentile(samples, reps, 0.95);
+  out->p99 = percentile(samples, reps, 0.99);
+  out->max = samples[reps - 1];
+}
+
+static void operands_init(BenchOperands *operands, long n) {
+  mpz_init(operands->fn);
+  mpz_init(operands->q11);
+  mpz_init(operands->q12);
+  mpz_init(operands->q21);
+  mpz_init(operands->q22);
+  mpz_init(operands->c11);
+  mpz_init(operands->c12);
+  mpz_init(operands->c21);
+  mpz_init(operands->c22);
+
+  // Q^n = [[F(n+1), F(n)], [F(n), F(n-1)]], so multiplying it by itself is the last squaring of
+  // a matrix_power run for 2n
+  calculate_fibonacci_pair(operands->q12, operands->q11, n, 0);
+  mpz_set(operands->q21, operands->q12);
+  mpz_sub(operands->q22, operands->q11, operands->q12);
+  mpz_set(operands->fn, operands->q12);
+}
+
+static void operands_clear(BenchOperands *operands) {
+  mpz_clear(operands->fn);
+  mpz_clear(operands->q11);
+  mpz_clear(operands->q12);
+  mpz_clear(operands->q21);
+  mpz_clear(operands->q22);
+  mpz_clear(operands->c11);
+  mpz_clear(operands->c12);
+  mpz_clear(operands->c21);
+  mpz_clear(operands->c22);
+}
+
+static int write_results(FILE *output, const BenchResult *results, int count, int json) {
+  int status = 0;
+  if (json) {
+    status |= fprintf(output, "{\"benchmarks\": [\n") < 0;
+  } else {
+    status |= fprintf(output, "benchmark,n,reps,batch,min_seconds,p25_seconds,median_seconds,"
+                              "p75_seconds,p95_seconds,p99_seconds,max_seconds\n") < 0;
+  }
+  for (int i = 0; i < count; i++) {
+    const BenchResult *r = &results[i];
+    if (json) {
+      status |= fprintf(output,
+                        "  {\"benchmark\": \"%s\", \"n\": %ld, \"median_seconds\": %.9e, "
+                        "\"reps\": %d, \"batch\": %ld, \"min_seconds\": %.9e, "
+                        "\"p25_seconds\": %.9e, \"p75_seconds\": %.9e, \"p95_seconds\": %.9e, "
+                        "\"p99_seconds\": %.9e, \"max_seconds\": %.9e}%s\n",
+                        benchmark_names[r->benchmark], r->n, r->median, r->reps, r->batch, r->min,
+                        r->p25, r->p75, r->p95, r->p99, r->max, i + 1 < count ? "," : "") < 0;
+    } else {
+      status |= fprintf(output, "%s,%ld,%d,%ld,%.9e,%.9e,%.9e,%.9e,%.9e,%.9e,%.9e\n",
+                        benchmark_names[r->benchmark], r->n, r->reps, r->batch, r->min, r->p25,
+                        r->median, r->p75, r->p95, r->p99, r->max) < 0;
+    }
+  }
+  if (json) {
+    status |= fprintf(output, "]}\n") < 0;
+  }
+  return status ? -1 : 0;
+}
+
+/**
+ * Reads the median and interquartile range of one benchmark line of an earlier run, in either
+ * output format. Lines written before the quartiles were recorded do not count as results.
+ *
+ * @param name receives the benchmark name; room for 64 bytes
+ * @return 0 if the line holds a result, -1 otherwise
+ */
+static int parse_baseline_line(const char *line, char *name, long *n, double *median,
+                               double *iqr) {
+  double p25, p75, max;
+  if (strchr(line, '{') != NULL) {
+    const char *lower = strstr(line, "\"p25_seconds\": ");
+    const char *upper = strstr(line, "\"p75_seconds\": ");
+    if (lower == NULL || upper == NULL ||
+        sscanf(line, " {\"benchmark\": \"%63[^\"]\", \"n\": %ld, \"median_seconds\": %lf", name,
+               n, median) != 3 ||
+        sscanf(lower, "\"p25_seconds\": %lf", &p25) != 1 ||
+        sscanf(upper, "\"p75_seconds\": %lf", &p75) != 1) {
+      return -1;
+    }
+  } else if (sscanf(line, "%63[^,],%ld,%*d,%*d,%*f,%lf,%lf,%lf,%*f,%*f,%lf", name, n, &p25, median,
+                    &p75, &max) != 6) {
+    return -1;
+  }
+  *iqr = p75 - p25;
+  return 0;
+}
+
+/**
+ * Times a suspected regression again, after the rest of the grid; load from other processes
+ * comes in bursts that seldom last that long, while a real slowdown does.
+ *
+ * @return 1 if the median of every rerun is still over the limit, 0 otherwise
+ */
+static int confirm_regression(const BenchResult *result, int warmup, double *samples,
+                              double limit) {
+  BenchOperands operands;
+  operands_init(&operands, result->n);
+  int confirmed = 1;
+  for (int run = 0; run < BENCH_CONFIRM_RUNS && confirmed; run++) {
+    BenchResult rerun;
+    fprintf(stderr, "Re-timing %s at n=%ld\n", benchmark_names[result->benchmark], result->n);
+    run_benchmark(&rerun, result->benchmark, result->n, result->reps, warmup, &operands, samples);
+    confirmed = rerun.median > limit;
+  }
+  operands_clear(&operands);
+  return confirmed;
+}
+
+/**
+ * Flags every benchmark whose median exceeds both the baseline median plus threshold percent
+ * and the baseline median plus BENCH_NOISE_IQRS interquartile ranges, and still does when it
+ * is timed again.
+ *
+ * @param samples scratch room for one benchmark's samples
+ * @return number of regressions, or -1 if the baseline cannot be read
+ */
+static int compare_baseline(const char *path, const BenchResult *results, int count,
+                            double threshold, int warmup, double *samples) {
+  FILE *file = fopen(path, "r");
+  if (file == NULL) {
+    return -1;
+  }
+
+  int compared = 0;
+  int regressions = 0;
+  char line[512];
+  while (fgets(line, sizeof(line), file) != NULL) {
+    char name[64];
+    long n;
+    double base;
+    double iqr;
+    if (parse_baseline_line(line, name, &n, &base, &iqr) != 0 || !(base > 0.0)) {
+      continue;
+    }
+    double limit = base * (1.0 + threshold / 100.0);
+    if (base + BENCH_NOISE_IQRS * iqr > limit) {
+      limit = base + BENCH_NOISE_IQRS * iqr;
+    }
+    for (int i = 0; i < count; i++) {
+      if (results[i].n != n || strcmp(benchmark_names[results[i].benchmark], name) != 0) {
+        continue;
+      }
+      double change = (results[i].median / base - 1.0) * 100.0;
+      compared++;
+      if (results[i].median > limit && confirm_regression(&results[i], warmup, samples, limit)) {
+        regressions++;
+        fprintf(stderr, "REGRESSION %s n=%ld: median %.3e s vs baseline %.3e s (%+.1f%%)\n", name,
+                n, results[i].median, base, change);
+      }
+    }
+  }
+  fclose(file);
+
+  fprintf(stderr, "Compared %d benchmarks with %s: %d regression%s over %.1f%%\n", compared,
+          path, regressions, regressions == 1 ? "" : "s", threshold);
+  return regressions;
+}
+
+/**
+ * Pins the process to one CPU so samples are not spread across cores with different caches
+ * and clocks.
+ *
+ * @return 0 on success, -1 if pinning is unsupported or refused
+ */
+static int pin_to_cpu(int cpu) {
+#ifdef __linux__
+  if (cpu < 0) {
+    cpu = sched_getcpu();
+  }
+  if (cpu < 0 || cpu >= CPU_SETSIZE) {
+    return -1;
+  }
+  cpu_set_t set;
+  CPU_ZERO(&set);
+  CPU_SET(cpu, &set);
+  if (sched_setaffinity(0, sizeof(set), &set) != 0) {
+    return -1;
+  }
+  fprintf(stderr, "Pinned to CPU %d\n", cpu);
+  return 0;
+#else
+  (void) cpu;
+  return -1;
+#endif
+}
+
+static int parse_long_option(const char *option, const char *value, long minimum, long *out) {
+  char *end;
+  errno = 0;
+  long parsed = value != NULL ? strtol(value, &end, 10) : 0;
+  if (value == NULL || value == end || *end || errno == ERANGE || parsed < minimum) {
+    fprintf(stderr, "Error: Invalid value '%s' for %s option\n", value != NULL ? value : "",
+            option);
+    return -1;
+  }
+  *out = parsed;
+  return 0;
+}
+
+int main(int argc, char *argv[]) {
+  long min_n = 1000;
+  long max_n = 1000000;
+  long points = 7;
+  long linear_max = 100000;
+  long reps = 101;
+  long warmup = 2;
+  long cpu = -1;
+  int pin = 1;
+  int json = 0;
+  const char *output_path = NULL;
+  const char *baseline_path = NULL;
+  double threshold = 10.0;
+
+  for (int i = 1; i < argc; i++) {
+    const char *value = i + 1 < argc ? argv[i + 1] : NULL;
+    int status = 0;
+    if (strcmp(argv[i], "--min") == 0) {
+      status = parse_long_option(argv[i], value, 2, &min_n);
+      i++;
+    } else if (strcmp(argv[i], "--max") == 0) {
+      status = parse_long_option(argv[i], value, 2, &max_n);
+      i++;
+    } else if (strcmp(argv[i], "--points") == 0) {
+      status = parse_long_option(argv[i], value, 1, &points);
+      i++;
+    } else if (strcmp(argv[i], "--linear-max") == 0) {
+      status = parse_long_option(argv[i], value, 0, &linear_max);
+      i++;
+    } else if (strcmp(argv[i], "--reps") == 0) {
+      status = parse_long_option(argv[i], value, 1, &reps);
+      i++;
+    } else if (strcmp(argv[i], "--warmup") == 0) {
+      status = parse_long_option(argv[i], value, 0, &warmup);
+      i++;
+    } else if (strcmp(argv[i], "--cpu") == 0) {
+      status = parse_long_option(argv[i], value, 0, &cpu);
+      i++;
+    } else if (strcmp(argv[i], "--no-pin") == 0) {
+      pin = 0;
+    } else if (strcmp(argv[i], "--json") == 0) {
+      json = 1;
+    } else if (strcmp(argv[i], "-o") == 0 && value != NULL) {
+      output_path = value;
+      i++;
+    } else if (strcmp(argv[i], "--baseline") == 0 && value != NULL) {
+      baseline_path = value;
+      i++;
+    } else if (strcmp(argv[i], "--threshold") == 0 && value != NULL) {
+      char *end;
+      threshold = strtod(value, &end);
+      if (value == end || *end || !(threshold >= 0.0)) {
+        fprintf(stderr, "Error: Invalid value '%s' for --threshold option\n", value);
+        return EXIT_FAILURE;
+      }
+      i++;
+    } else {
+      fprintf(stderr, "Error: Unknown option '%s' (see the comment at the top of bench.c)\n",
+              argv[i]);
+      return EXIT_FAILURE;
+    }
+    if (status != 0) {
+      return EXIT_FAILURE;
+    }
+  }
+  if (max_n < min_n) {
+    fprintf(stderr, "Error: --max must not be below --min\n");
+    return EXIT_FAILURE;
+  }
+
+  if (pin && pin_to_cpu((int) cpu) != 0) {
+    fprintf(stderr, "Warning: Cannot pin to a CPU; timings may be noisier\n");
+  }
+
+  BenchResult *results = malloc(BENCH_MAX_RESULTS * sizeof(BenchResult));
+  double *samples = malloc((size_t) reps * sizeof(double));
+  if (results == NULL || samples == NULL) {
+    fprintf(stderr, "Error: Out of memory\n");
+    free(results);
+    free(samples);
+    return EXIT_FAILURE;
+  }
+
+  int count = 0;
+  long previous = 0;
+  for (long p = 0; p < points && count + BENCHMARKS <= BENCH_MAX_RESULTS; p++) {
+    double step = points > 1 ? (double) p / (double) (points - 1) : 0.0;
+    long n = (long) llround(exp(log((double) min_n) + step * log((double) max_n / min_n)));
+    if (n == previous) {
+      continue;
+    }
+    previous = n;
+
+    BenchOperands operands;
+    operands_init(&operands, n);
+    for (int b = 0; b < BENCHMARKS; b++) {
+      // The additive engines are quadratic; past linear_max they would dominate the run
+      if ((b == BENCH_ITERATIVE || b == BENCH_RECURSIVE) && n > linear_max) {
+        continue;
+      }
+      fprintf(stderr, "Timing %s at n=%ld\n", benchmark_names[b], n);
+      run_benchmark(&results[count], (Benchmark) b, n, (int) reps, (int) warmup, &operands,
+                    samples);
+      count++;
+    }
+    operands_clear(&operands);
+  }
+
+  FILE *output = stdout;
+  if (output_path != NULL) {
+    output = fopen(output_path, "w");
+    if (output == NULL) {
+      fprintf(stderr, "Error: Cannot open '%s' for writing\n", output_path);
+      free(results);
+      free(samples);
+      return EXIT_FAILURE;
+    }
+  }
+  int status = write_results(output, results, count, json);
+  if (output != stdout && fclose(output) != 0) {
+    status = -1;
+  }
+  if (status != 0) {
+    fprintf(stderr, "Error: Cannot write the results\n");
+    free(results);
+    free(samples);
+    return EXIT_FAILURE;
+  }
+
+  int regressions = 0;
+  if (baseline_path != NULL) {
+    regressions =
+        compare_baseline(baseline_path, results, count, threshold, (int) warmup, samples);
+    if (regressions < 0) {
+      fprintf(stderr, "Error: Cannot read baseline '%s'\n", baseline_path);
+      free(results);
+      free(samples);
+      return EXIT_FAILURE;
+    }
+  }
+  free(results);
+  free(samples);
+  return regressions > 0 ? EXIT_FAILURE : EXIT_SUCCESS;
+}
@@ -0,0 +1,362 @@
+#include "fib.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+// Below this index the exact engines are cheaper than setting up the float path
+#define BINET_EXACT_THRESHOLD 1000
+// Extra digits carried beyond the requested ones and the digits of n
+#define BINET_GUARD_DIGITS 20
+// Precision retries (each doubling the guard) before falling back to exact
+#define BINET_MAX_RETRIES 2
+
+// Margin (in bits) kept between the log estimate and the nearest integer
+#define BINET_LOG_MARGIN_BITS 96
+
+static unsigned long bit_length(unsigned long value) {
+  unsigned long bits = 0;
+  while (value != 0) {
+    bits++;
+    value >>= 1;
+  }
+  return bits;
+}
+
+/**
+ * Computes F(n) exactly and derives its leading digits and digit count.
+ * Used for small n and whenever the floating-point bracket is ambiguous.
+ */
+static void leading_digits_exact(mpz_t leading, size_t *digit_count, long n, unsigned long k,
+                                 int base, int verbose) {
+  mpz_t value, scale;
+  mpz_init(value);
+  mpz_init(scale);
+
+  if (verbose) {
+    fprintf(stderr, "Computing F(%ld) exactly for its leading digits\n", n);
+  }
+
+  calculate_fibonacci_matrix(value, n, 0);
+
+  // mpz_sizeinbase may overshoot by one for bases that are not powers of two
+  size_t digits = mpz_sizeinbase(value, base);
+  if (digits > 1) {
+    mpz_ui_pow_ui(scale, (unsigned long) base, (unsigned long) (digits - 1));
+    if (mpz_cmp(value, scale) < 0) {
+      digits--;
+    }
+  }
+
+  if (digits > k) {
+    mpz_ui_pow_ui(scale, (unsigned long) base, (unsigned long) (digits - k));
+    mpz_tdiv_q(leading, value, scale);
+  } else {
+    mpz_set(leading, value);
+  }
+  *digit_count = digits;
+
+  mpz_clear(value);
+  mpz_clear(scale);
+}
+
+/**
+ * Tries to derive the leading k digits of F(n) from phi^n / sqrt(5) evaluated with
+ * guard_digits extra digits of precision.
+ *
+ * The computed quotient y = F(n) / base^(e - k) is bracketed by the accumulated rounding
+ * error of the mpf operations, including the rounding of phi that phi^n amplifies n-fold,
+ * plus the |psi^n / sqrt(5)| < 1/2 term dropped from Binet's formula. The digits are only accepted when both ends of the bracket floor to the same
+ * k-digit integer.
+ *
+ * @return 1 if the digits were determined, 0 if the result lies too close to a boundary,
+ *         -1 if F(n) has no more than k digits
+ */
+static int leading_digits_binet(mpz_t leading, size_t *digit_count, long n, unsigned long k,
+                                int base, unsigned long guard_digits) {
+  unsigned long n_bits = bit_length((unsigned long) n);
+  unsigned long base_bits = bit_length((unsigned long) base);
+  mp_bitcnt_t prec = (mp_bitcnt_t) ((k + guard_digits) * base_bits + n_bits + 64);
+
+  mpf_t sqrt5, value, scale, error, bound;
+  mpf_init2(sqrt5, prec);
+  mpf_init2(value, prec);
+  mpf_init2(scale, prec);
+  mpf_init2(error, prec);
+  mpf_init2(bound, prec);
+
+  mpz_t lo, hi, limit;
+  mpz_init(lo);
+  mpz_init(hi);
+  mpz_init(limit);
+
+  // value = phi^n / sqrt(5), phi = (1 + sqrt(5)) / 2
+  mpf_sqrt_ui(sqrt5, 5);
+  mpf_add_ui(value, sqrt5, 1);
+  mpf_div_2exp(value, value, 1);
+  mpf_pow_ui(value, value, (unsigned long) n);
+  mpf_div(value, value, sqrt5);
+
+  // Number of base-digits in the integer part (0.d1d2... * base^exponent)
+  mp_exp_t exponent;
+  char *probe = mpf_get_str(NULL, &exponent, base, 2, value);
+  void (*free_func)(void *, size_t);
+  mp_get_memory_functions(NULL, NULL, &free_func);
+  free_func(probe, strlen(probe) + 1);
+
+  int found = -1;
+  if (exponent > 0 && (unsigned long) exponent > k) {
+    found = 0;
+    unsigned long shift = (unsigned long) exponent - k;
+    mpf_set_ui(scale, (unsigned long) base);
+    mpf_pow_ui(scale, scale, shift);
+    mpf_div(value, value, scale);
+
+    // The probe exponent is one too large when mpf_get_str rounded up to a new digit
+    size_t digits = (size_t) exponent;
+    mpf_set_ui(bound, (unsigned long) base);
+    mpf_pow_ui(bound, bound, k - 1);
+    if (mpf_cmp(value, bound) < 0) {
+      mpf_mul_ui(value, value, (unsigned long) base);
+      mpf_div_ui(scale, scale, (unsigned long) base);
+      digits--;
+    }
+
+    // Relative error: one rounding per mpf operation, two per squaring step of each power,
+    // and phi's own error of two roundings (sqrt, add), which phi^n multiplies by n
+    unsigned long operations = 2 * (n_bits + bit_length(shift)) + 8;
+    mpf_set_ui(error, operations + 2 * (unsigned long) n);
+    mpf_div_2exp(error, error, mpf_get_prec(value) - 1);
+    mpf_mul(error, error, value);
+
+    // Absolute error contributed by the dropped psi^n term, scaled down with the value
+    mpf_ui_div(bound, 1, scale);
+    mpf_div_2exp(bound, bound, 1);
+    mpf_add(error, error, bound);
+
+    mpf_sub(bound, value, error);
+    mpz_set_f(lo, bound);
+    mpf_add(bound, value, error);
+    mpz_set_f(hi, bound);
+
+    // Accept only when the whole bracket floors to the same k-digit integer
+    mpz_ui_pow_ui(limit, (unsigned long) base, k);
+    if (mpz_cmp(lo, hi) == 0 && mpz_cmp(hi, limit) < 0) {
+      mpz_ui_pow_ui(limit, (unsigned long) base, k - 1);
+      if (mpz_cmp(lo, limit) >= 0) {
+        mpz_set(leading, lo);
+        *digit_count = digits;
+        found = 1;
+      }
+    }
+  }
+
+  mpz_clear(lo);
+  mpz_clear(hi);
+  mpz_clear(limit);
+  mpf_clear(sqrt5);
+  mpf_clear(value);
+  mpf_clear(scale);
+  mpf_clear(error);
+  mpf_clear(bound);
+
+  return found;
+}
+
+int fibonacci_leading_digits(mpz_t leading, size_t *digit_count, long n, unsigned long k,
+                             int base, int verbose) {
+  if (n < 0 || k == 0 || base < 2 || base > 62) {
+    return -1;
+  }
+
+  if (n < BINET_EXACT_THRESHOLD) {
+    leading_digits_exact(leading, digit_count, n, k, base, verbose);
+    return 0;
+  }
+
+  // Digits of n in the requested base, so the precision grows with log(n)
+  unsigned long guard = BINET_GUARD_DIGITS;
+  for (unsigned long rest = (unsigned long) n; rest != 0; rest /= (unsigned long) base) {
+    guard++;
+  }
+
+  for (int attempt = 0; attempt <= BINET_MAX_RETRIES; attempt++) {
+    if (verbose) {
+      fprintf(stderr, "Evaluating phi^n/sqrt(5) with %lu guard digits\n", guard);
+    }
+    int status = leading_digits_binet(leading, digit_count, n, k, base, guard);
+    if (status > 0) {
+      return 0;
+    } else if (status < 0) {
+      break;
+    }
+    if (verbose) {
+      fprintf(stderr, "Result is close to a rounding boundary, increasing precision\n");
+    }
+    guard *= 2;
+  }
+
+  // Either F(n) has at most k digits or the value sits on a digit boundary
+  leading_digits_exact(leading, digit_count, n, k, base, verbose);
+  return 0;
+}
+
+/**
+ * Computes atanh(z) = z + z^3/3 + z^5/5 + ... for 0 < z < 1 to about prec bits.
+ */
+static void series_atanh(mpf_t result, const mpf_t z, mp_bitcnt_t prec) {
+  mpf_t z2, power, term;
+  mpf_init2(z2, prec);
+  mpf_init2(power, prec);
+  mpf_init2(term, prec);
+
+  mpf_mul(z2, z, z);
+  mpf_set(power, z);
+  mpf_set(result, z);
+
+  for (unsigned long i = 1;; i++) {
+    mpf_mul(power, power, z2);
+    mpf_div_ui(term, power, 2 * i + 1);
+
+    // Stop once the term falls below the last bit we carry
+    long term_exp, result_exp;
+    mpf_get_d_2exp(&term_exp, term);
+    mpf_get_d_2exp(&result_exp, result);
+    if (mpf_sgn(term) == 0 || result_exp - term_exp > (long) prec + 2) {
+      break;
+    }
+    mpf_add(result, result, term);
+  }
+
+  mpf_clear(z2);
+  mpf_clear(power);
+  mpf_clear(term);
+}
+
+/**
+ * Computes log_base(F(n)) ~ n*log(phi) - log(sqrt(5)) in the given base, to prec bits.
+ * Only bases that are powers of two or ten are supported.
+ */
+static int binet_log(mpf_t result, long n, int base, mp_bitcnt_t prec) {
+  int twos = 0;
+  int fives = 0;
+  for (int rest = base; rest > 1;) {
+    if (rest % 2 == 0) {
+      twos++;
+      rest /= 2;
+    } else if (rest % 5 == 0) {
+      fives++;
+      rest /= 5;
+    } else {
+      return -1;
+    }
+  }
+  if (fives > 0 && fives != twos) {
+    return -1;
+  }
+
+  mpf_t ln2, ln5, ln_phi, ln_base, z;
+  mpf_init2(ln2, prec);
+  mpf_init2(ln5, prec);
+  mpf_init2(ln_phi, prec);
+  mpf_init2(ln_base, prec);
+  mpf_init2(z, prec);
+
+  // ln 2 = 2 atanh(1/3), ln 5 = 2 ln 2 + ln(5/4) = 2 ln 2 + 2 atanh(1/9)
+  mpf_set_ui(z, 1);
+  mpf_div_ui(z, z, 3);
+  series_atanh(ln2, z, prec);
+  mpf_mul_2exp(ln2, ln2, 1);
+
+  mpf_set_ui(z, 1);
+  mpf_div_ui(z, z, 9);
+  series_atanh(ln5, z, prec);
+  mpf_mul_2exp(ln5, ln5, 1);
+  mpf_add(ln5, ln5, ln2);
+  mpf_add(ln5, ln5, ln2);
+
+  // ln phi = 2 atanh(1/phi^3) with 1/phi^3 = sqrt(5) - 2
+  mpf_sqrt_ui(z, 5);
+  mpf_sub_ui(z, z, 2);
+  series_atanh(ln_phi, z, prec);
+  mpf_mul_2exp(ln_phi, ln_phi, 1);
+
+  mpf_mul_ui(ln_base, ln2, (unsigned long) twos);
+  if (fives > 0) {
+    mpf_mul_ui(z, ln5, (unsigned long) fives);
+    mpf_add(ln_base, ln_base, z);
+  }
+
+  // result = (n ln phi - ln 5 / 2) / ln base
+  mpf_mul_ui(result, ln_phi, (unsigned long) n);
+  mpf_div_2exp(ln5, ln5, 1);
+  mpf_sub(result, result, ln5);
+  mpf_div(result, result, ln_base);
+
+  mpf_clear(ln2);
+  mpf_clear(ln5);
+  mpf_clear(ln_phi);
+  mpf_clear(ln_base);
+  mpf_clear(z);
+  return 0;
+}
+
+int fibonacci_digit_count(size_t *digit_count, long n, int base, int verbose) {
+  if (n < 0 || base < 2 || base > 62) {
+    return -1;
+  }
+
+  mpz_t leading;
+  mpz_init(leading);
+
+  // For small n the log(1 - (psi/phi)^n) correction term is not negligible
+  if (n < BINET_EXACT_THRESHOLD) {
+    int status = fibonacci_leading_digits(leading, digit_count, n, 1, base, verbose);
+    mpz_clear(leading);
+    return status;
+  }
+
+  unsigned long n_bits = bit_length((unsigned long) n);
+  mp_bitcnt_t prec = (mp_bitcnt_t) (n_bits + BINET_LOG_MARGIN_BITS + 64);
+
+  mpf_t estimate, bound;
+  mpf_init2(estimate, prec);
+  mpf_init2(bound, prec);
+
+  mpz_t lo, hi;
+  mpz_init(lo);
+  mpz_init(hi);
+
+  int status = binet_log(estimate, n, base, prec);
+  int resolved = 0;
+  if (status == 0) {
+    // Interval [estimate - delta, estimate + delta]: the constants carry prec bits and
+    // are scaled by n, so keep BINET_LOG_MARGIN_BITS of slack after that loss
+    mpf_set_ui(bound, 1);
+    mpf_div_2exp(bound, bound, BINET_LOG_MARGIN_BITS);
+    mpf_sub(estimate, estimate, bound);
+    mpz_set_f(lo, estimate);
+    mpf_mul_2exp(bound, bound, 1);
+    mpf_add(estimate, estimate, bound);
+    mpz_set_f(hi, estimate);
+
+    if (mpz_cmp(lo, hi) == 0 && mpz_fits_ulong_p(lo)) {
+      *digit_count = (size_t) mpz_get_ui(lo) + 1;
+      resolved = 1;
+    }
+  }
+
+  if (!resolved) {
+    // log(F(n)) lies too close to an integer: decide with a leading-digit check
+    if (verbose) {
+      fprintf(stderr, "Digit count is on a boundary, checking leading digits\n");
+    }
+    status = fibonacci_leading_digits(leading, digit_count, n, 1, base, verbose);
+  }
+
+  mpz_clear(lo);
+  mpz_clear(hi);
+  mpz_clear(leading);
+  mpf_clear(estimate);
+  mpf_clear(bound);
+  return status;
+}
@@ -0,0 +1,4 @@
+#ifndef BUILD_ID_H
+#define BUILD_ID_H
+#define BUILD_ID "aq406y"
+#endif
@@ -0,0 +1,737 @@
+#ifdef __linux__
+#define _GNU_SOURCE  // copy_file_range
+#endif
+
+#include "fib.h"
+#include "probes.h"
+#include <dirent.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/file.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#ifdef __linux__
+#include <sys/sendfile.h>
+#endif
+
+// Cached pairs this close to n are reached with single additions instead of a computation
+#define CACHE_STEP_LIMIT 1024
+#define CACHE_MAGIC "FIBPAIR1"
+#define CACHE_BYTE_ORDER 0x0102030405060708ULL
+
+// File layout: this header, then the limbs of F(k), then the limbs of F(k + 1)
+typedef struct {
+  char magic[8];
+  uint64_t byte_order;  // rejects files written on a machine of the other endianness
+  uint64_t limb_bits;   // rejects files written with a different GMP limb size
+  uint64_t index;
+  uint64_t fn_limbs;
+  uint64_t fn1_limbs;
+  uint64_t fn_checksum;  // XXH64 of the limbs of F(k)
+  uint64_t fn1_checksum;
+} PairHeader;
+
+struct CacheLock {
+  int fd;
+  char *path;
+};
+
+typedef enum { PLAN_FRESH, PLAN_STEP, PLAN_DOUBLE, PLAN_ADD } CachePlan;
+
+typedef struct {
+  char name[64];
+  off_t size;
+  struct timespec used;
+} CacheEntry;
+
+static char *entry_path(const char *dir, long n) {
+  size_t len = strlen(dir) + 48;
+  char *path = malloc(len);
+  if (path != NULL) {
+    snprintf(path, len, "%s/pair-%ld.bin", dir, n);
+  }
+  return path;
+}
+
+/**
+ * Parses the index out of a cache entry name of the form pair-<k>.bin.
+ *
+ * @return the index, or -1 if name is not a cache entry
+ */
+static long entry_index(const char *name) {
+  if (strncmp(name, "pair-", 5) != 0) {
+    return -1;
+  }
+  char *end;
+  long k = strtol(name + 5, &end, 10);
+  if (end == name + 5 || k < 0 || strcmp(end, ".bin") != 0) {
+    return -1;
+  }
+  return k;
+}
+
+/**
+ * Tells whether name is a cache entry subject to the size budget: a pair-<k>.bin pair or a
+ * render-<k>-<format>-<style>.txt rendering.
+ */
+static int is_cache_entry(const char *name) {
+  if (entry_index(name) >= 0) {
+    return 1;
+  }
+  size_t len = strlen(name);
+  return strncmp(name, "render-", 7) == 0 && len > 11 && strcmp(name + len - 4, ".txt") == 0;
+}
+
+static char *render_path(const char *dir, long n, OutputFormat format, int raw_output) {
+  size_t len = strlen(dir) + 64;
+  char *path = malloc(len);
+  if (path != NULL) {
+    snprintf(path, len, "%s/render-%ld-%s-%s.txt", dir, n, format_to_string(format),
+             raw_output ? "raw" : "label");
+  }
+  return path;
+}
+
+static void import_limbs(mpz_t value, const mp_limb_t *limbs, size_t count) {
+  if (count == 0) {
+    mpz_set_ui(value, 0);
+    return;
+  }
+  mp_limb_t *dest = mpz_limbs_write(value, (mp_size_t) count);
+  memcpy(dest, limbs, count * sizeof(mp_limb_t));
+  mpz_limbs_finish(value, (mp_size_t) count);
+}
+
+/**
+ * Maps the entry for n and copies F(n) and F(n + 1) out of it. An entry that fails any
+ * header or checksum test is removed so it is recomputed and rewritten.
+ *
+ * @return 0 on a valid hit, -1 otherwise
+ */
+static int load_pair(const char *dir, long n, mpz_t fn, mpz_t fn1) {
+  char *path = entry_path(dir, n);
+  if (path == NULL) {
+    return -1;
+  }
+  int fd = open(path, O_RDONLY);
+  if (fd == -1) {
+    free(path);
+    return -1;
+  }
+
+  int status = -1;
+  struct stat st;
+  if (fstat(fd, &st) == 0 && (size_t) st.st_size >= sizeof(PairHeader)) {
+    void *map = mmap(NULL, (size_t) st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    if (map != MAP_FAILED) {
+      const PairHeader *header = map;
+      const mp_limb_t *limbs = (const mp_limb_t *) (header + 1);
+      size_t payload = (size_t) st.st_size - sizeof(PairHeader);
+      // The limb counts are untrusted: each is bounded before they are multiplied, so a
+      // crafted header cannot wrap the product into a match and send the checksum past the map
+      if (memcmp(header->magic, CACHE_MAGIC, 8) == 0 &&
+          header->byte_order == CACHE_BYTE_ORDER && header->limb_bits == GMP_LIMB_BITS &&
+          header->index == (uint64_t) n &&
+          header->fn_limbs <= payload / sizeof(mp_limb_t) &&
+          header->fn1_limbs <= payload / sizeof(mp_limb_t) - header->fn_limbs &&
+          payload == (header->fn_limbs + header->fn1_limbs) * sizeof(mp_limb_t) &&
+          digest_xxh64(limbs, header->fn_limbs * sizeof(mp_limb_t)) == header->fn_checksum &&
+          digest_xxh64(limbs + header->fn_limbs, header->fn1_limbs * sizeof(mp_limb_t)) ==
+              header->fn1_checksum) {
+        import_limbs(fn, limbs, header->fn_limbs);
+        import_limbs(fn1, limbs + header->fn_limbs, header->fn1_limbs);
+        status = 0;
+      }
+      munmap(map, (size_t) st.st_size);
+    }
+  }
+
+  if (status == 0) {
+    // Refresh the modification time: eviction removes the least recently used entries
+    futimens(fd, NULL);
+  } else {
+    unlink(path);
+  }
+  close(fd);
+  free(path);
+  return status;
+}
+
+static int write_all(int fd, const void *data, size_t len) {
+  const char *p = data;
+  while (len > 0) {
+    ssize_t written = write(fd, p, len);
+    if (written <= 0) {
+      return -1;
+    }
+    p += written;
+    len -= (size_t) written;
+  }
+  return 0;
+}
+
+static int compare_entries_by_use(const void *a, const void *b) {
+  const CacheEntry *x = a;
+  const CacheEntry *y = b;
+  if (x->used.tv_sec != y->used.tv_sec) {
+    return x->used.tv_sec < y->used.tv_sec ? -1 : 1;
+  }
+  if (x->used.tv_nsec != y->used.tv_nsec) {
+    return x->used.tv_nsec < y->used.tv_nsec ? -1 : 1;
+  }
+  return 0;
+}
+
+/**
+ * Removes the least recently used entries until the cache fits in budget_bytes.
+ */
+static void enforce_budget(const char *dir, unsigned long long budget_bytes, int verbose) {
+  DIR *handle = opendir(dir);
+  if (handle == NULL) {
+    return;
+  }
+
+  CacheEntry *entries = NULL;
+  size_t count = 0, capacity = 0;
+  unsigned long long total = 0;
+  struct dirent *ent;
+  while ((ent = readdir(handle)) != NULL) {
+    struct stat st;
+    if (!is_cache_entry(ent->d_name) || strlen(ent->d_name) >= sizeof(entries->name) ||
+        fstatat(dirfd(handle), ent->d_name, &st, 0) != 0) {
+      continue;
+    }
+    if (count == capacity) {
+      size_t grown = capacity ? capacity * 2 : 64;
+      CacheEntry *resized = realloc(entries, grown * sizeof(CacheEntry));
+      if (resized == NULL) {
+        break;
+      }
+      entries = resized;
+      capacity = grown;
+    }
+    strcpy(entries[count].name, ent->d_name);
+    entries[count].size = st.st_size;
+    entries[count].used = st.st_mtim;
+    total += (unsigned long long) st.st_size;
+    count++;
+  }
+
+  if (total > budget_bytes) {
+    qsort(entries, count, sizeof(CacheEntry), compare_entries_by_use);
+    for (size_t i = 0; i < count && total > budget_bytes; i++) {
+      if (unlinkat(dirfd(handle), entries[i].name, 0) == 0) {
+        total -= (unsigned long long) entries[i].size;
+        if (verbose) {
+          fprintf(stderr, "Evicted cache entry %s\n", entries[i].name);
+        }
+      }
+    }
+  }
+
+  free(entries);
+  closedir(handle);
+}
+
+/**
+ * Takes an exclusive flock on the lock file of key in dir, waiting for the current holder.
+ * The holder removes the file before unlocking, so a waiter that wakes up holding a removed
+ * file opens the new one and waits again.
+ *
+ * @return the held lock, or NULL if locking is unavailable
+ */
+static CacheLock *lock_acquire(const char *dir, const char *key, int verbose) {
+  size_t len = strlen(dir) + strlen(key) + 8;
+  CacheLock *lock = malloc(sizeof(CacheLock));
+  char *path = malloc(len);
+  if (lock == NULL || path == NULL) {
+    free(lock);
+    free(path);
+    return NULL;
+  }
+  snprintf(path, len, "%s/.%s.lock", dir, key);
+
+  for (;;) {
+    int fd = open(path, O_RDWR | O_CREAT, S_IRUSR | S_IWUSR);
+    if (fd == -1) {
+      break;
+    }
+    if (flock(fd, LOCK_EX | LOCK_NB) != 0) {
+      if (verbose) {
+        fprintf(stderr, "Waiting for another process working on %s\n", key);
+      }
+      int locked;
+      do {
+        locked = flock(fd, LOCK_EX);
+      } while (locked != 0 && errno == EINTR);
+      if (locked != 0) {
+        close(fd);
+        break;
+      }
+    }
+
+    struct stat held, current;
+    if (fstat(fd, &held) == 0 && stat(path, &current) == 0 && held.st_dev == current.st_dev &&
+        held.st_ino == current.st_ino) {
+      lock->fd = fd;
+      lock->path = path;
+      return lock;
+    }
+    close(fd);
+  }
+
+  free(lock);
+  free(path);
+  return NULL;
+}
+
+void cache_lock_release(CacheLock *lock) {
+  if (lock == NULL) {
+    return;
+  }
+  unlink(lock->path);
+  close(lock->fd);
+  free(lock->path);
+  free(lock);
+}
+
+CacheLock *render_cache_lock(long n, OutputFormat format, int raw_output, int verbose) {
+  char *dir = get_cache_directory();
+  if (dir == NULL) {
+    return NULL;
+  }
+  char key[64];
+  snprintf(key, sizeof(key), "render-%ld-%s-%s", n, format_to_string(format),
+           raw_output ? "raw" : "label");
+  CacheLock *lock = lock_acquire(dir, key, verbose);
+  free(dir);
+  return lock;
+}
+
+/**
+ * Publishes the pair for n through a temporary file and a rename, so readers only ever see
+ * complete entries.
+ */
+static void store_pair(const char *dir, long n, const mpz_t fn, const mpz_t fn1,
+                       unsigned long long budget_bytes, int verbose) {
+  PairHeader header;
+  memset(&header, 0, sizeof(header));
+  memcpy(header.magic, CACHE_MAGIC, 8);
+  header.byte_order = CACHE_BYTE_ORDER;
+  header.limb_bits = GMP_LIMB_BITS;
+  header.index = (uint64_t) n;
+  header.fn_limbs = mpz_size(fn);
+  header.fn1_limbs = mpz_size(fn1);
+
+  size_t fn_bytes = header.fn_limbs * sizeof(mp_limb_t);
+  size_t fn1_bytes = header.fn1_limbs * sizeof(mp_limb_t);
+  if (sizeof(header) + fn_bytes + fn1_bytes > budget_bytes) {
+    if (verbose) {
+      fprintf(stderr, "F(%ld) is larger than the cache budget; not cached\n", n);
+    }
+    return;
+  }
+  header.fn_checksum = digest_xxh64(mpz_limbs_read(fn), fn_bytes);
+  header.fn1_checksum = digest_xxh64(mpz_limbs_read(fn1), fn1_bytes);
+
+  char *path = entry_path(dir, n);
+  size_t tmp_len = strlen(dir) + 48;
+  char *tmp_path = malloc(tmp_len);
+  if (path == NULL || tmp_path == NULL) {
+    free(path);
+    free(tmp_path);
+    return;
+  }
+  snprintf(tmp_path, tmp_len, "%s/.pair-%ld.XXXXXX", dir, n);
+
+  int fd = mkstemp(tmp_path);
+  if (fd != -1) {
+    int ok = write_all(fd, &header, sizeof(header)) == 0 &&
+             write_all(fd, mpz_limbs_read(fn), fn_bytes) == 0 &&
+             write_all(fd, mpz_limbs_read(fn1), fn1_bytes) == 0;
+    if (close(fd) != 0) {
+      ok = 0;
+    }
+    if (ok && rename(tmp_path, path) == 0) {
+      if (verbose) {
+        fprintf(stderr, "Cached F(%ld) and F(%ld) in %s\n", n, n + 1, path);
+      }
+      enforce_budget(dir, budget_bytes, verbose);
+    } else {
+      unlink(tmp_path);
+    }
+  }
+
+  free(path);
+  free(tmp_path);
+}
+
+/**
+ * Picks the cached index to start from. Nearby entries are reached by stepping; the matrix
+ * engine can also double up from an entry whose binary digits prefix those of n, or combine
+ * an entry covering at least half of n with a fresh pair for the rest. The iterative engines
+ * only ever add, so for them any smaller entry is a head start.
+ */
+static CachePlan choose_base(const char *dir, long n, Algorithm algo, long *base) {
+  DIR *handle = opendir(dir);
+  if (handle == NULL) {
+    return PLAN_FRESH;
+  }
+
+  long step = -1, prefix = -1, half = -1;
+  struct dirent *ent;
+  while ((ent = readdir(handle)) != NULL) {
+    long k = entry_index(ent->d_name);
+    if (k < 0 || k == n) {
+      continue;
+    }
+    long distance = k < n ? n - k : k - n;
+    if (distance <= CACHE_STEP_LIMIT || (algo != MATRIX && k < n)) {
+      long best = step < n ? n - step : step - n;
+      if (step < 0 || distance < best) {
+        step = k;
+      }
+      continue;
+    }
+    if (algo != MATRIX || k > n || k == 0) {
+      continue;
+    }
+    int shift = 0;
+    while ((n >> shift) > k) {
+      shift++;
+    }
+    if ((n >> shift) == k && k > prefix) {
+      prefix = k;
+    } else if (k >= n - k && k > half) {
+      half = k;
+    }
+  }
+  closedir(handle);
+
+  if (step >= 0) {
+    *base = step;
+    return PLAN_STEP;
+  }
+  if (prefix >= 0) {
+    *base = prefix;
+    return PLAN_DOUBLE;
+  }
+  if (half >= 0) {
+    *base = half;
+    return PLAN_ADD;
+  }
+  return PLAN_FRESH;
+}
+
+/**
+ * Moves the pair (F(k), F(k + 1)) to (F(n), F(n + 1)) one index at a time.
+ */
+static void step_pair(mpz_t fn, mpz_t fn1, long k, long n) {
+  mpz_t tmp;
+  mpz_init(tmp);
+  for (; k < n && !CALCULATION_CANCELLED(); k++) {
+    mpz_add(tmp, fn, fn1);
+    mpz_swap(fn, fn1);
+    mpz_swap(fn1, tmp);
+  }
+  for (; k > n; k--) {
+    // F(k - 1) = F(k + 1) - F(k)
+    mpz_sub(tmp, fn1, fn);
+    mpz_swap(fn1, fn);
+    mpz_swap(fn, tmp);
+  }
+  mpz_clear(tmp);
+}
+
+/**
+ * Doubles the pair (F(k), F(k + 1)) up to n, where k is n shifted right by some bits:
+ *   F(2k) = F(k) (2 F(k + 1) - F(k)),  F(2k + 1) = F(k)^2 + F(k + 1)^2
+ */
+static void double_pair(mpz_t fn, mpz_t fn1, long k, long n) {
+  int shift = 0;
+  while ((n >> shift) > k) {
+    shift++;
+  }
+
+  mpz_t even, odd;
+  mpz_init(even);
+  mpz_init(odd);
+  for (int bit = shift - 1; bit >= 0; bit--) {
+    mpz_mul_2exp(even, fn1, 1);
+    mpz_sub(even, even, fn);
+    mpz_mul(even, even, fn);
+    mpz_mul(odd, fn, fn);
+    mpz_addmul(odd, fn1, fn1);
+    if ((n >> bit) & 1) {
+      mpz_add(fn1, even, odd);
+      mpz_swap(fn, odd);
+    } else {
+      mpz_swap(fn, even);
+      mpz_swap(fn1, odd);
+    }
+  }
+  mpz_clear(even);
+  mpz_clear(odd);
+}
+
+/**
+ * Extends the pair (F(k), F(k + 1)) to n with a fresh pair for d = n - k:
+ *   F(k + d) = F(k) F(d + 1) + F(k - 1) F(d),  F(k + d + 1) = F(k + 1) F(d + 1) + F(k) F(d)
+ */
+static void add_pair(mpz_t fn, mpz_t fn1, long k, long n, int verbose) {
+  mpz_t gd, gd1, prev, next;
+  mpz_init(gd);
+  mpz_init(gd1);
+  mpz_init(prev);
+  mpz_init(next);
+
+  calculate_fibonacci_pair(gd, gd1, n - k, verbose);
+  mpz_sub(prev, fn1, fn);
+  mpz_mul(next, fn1, gd1);
+  mpz_addmul(next, fn, gd);
+  mpz_mul(fn, fn, gd1);
+  mpz_addmul(fn, prev, gd);
+  mpz_swap(fn1, next);
+
+  mpz_clear(gd);
+  mpz_clear(gd1);
+  mpz_clear(prev);
+  mpz_clear(next);
+}
+
+void calculate_fibonacci_cached(mpz_t result, long n, Algorithm algo,
+                                unsigned long long budget_bytes, int verbose) {
+  FIB_PROBE2(calc__start, "cached", n);
+  char *dir = get_cache_directory();
+  if (dir == NULL) {
+    if (verbose) {
+      fprintf(stderr, "Cache directory unavailable; computing without the cache\n");
+    }
+    if (algo == MATRIX) {
+      calculate_fibonacci_matrix(result, n, verbose);
+    } else {
+      calculate_fibonacci_iterative(result, n, verbose);
+    }
+    FIB_PROBE3(calc__done, "cached", n, (long) mpz_size(result));
+    return;
+  }
+
+  mpz_t fn, fn1;
+  mpz_init(fn);
+  mpz_init(fn1);
+
+  // Processes asking for the same n at once queue here while the first computes and
+  // publishes it; the others then read the published pair
+  CacheLock *lock = NULL;
+  int hit = load_pair(dir, n, fn, fn1) == 0;
+  if (!hit) {
+    char key[32];
+    snprintf(key, sizeof(key), "pair-%ld", n);
+    lock = lock_acquire(dir, key, verbose);
+    hit = lock != NULL && load_pair(dir, n, fn, fn1) == 0;
+  }
+  if (hit) {
+    if (verbose) {
+      fprintf(stderr, "Cache hit for F(%ld)\n", n);
+    }
+    mpz_swap(result, fn);
+    mpz_clear(fn);
+    mpz_clear(fn1);
+    cache_lock_release(lock);
+    free(dir);
+    FIB_PROBE3(calc__done, "cached", n, (long) mpz_size(result));
+    return;
+  }
+
+  long base = 0;
+  CachePlan plan = choose_base(dir, n, algo, &base);
+  if (plan != PLAN_FRESH && load_pair(dir, base, fn, fn1) != 0) {
+    plan = PLAN_FRESH;
+  }
+
+  switch (plan) {
+    case PLAN_STEP:
+      if (verbose) {
+        fprintf(stderr, "Stepping %ld indices from cached F(%ld)\n", base < n ? n - base : base - n,
+                base);
+      }
+      step_pair(fn, fn1, base, n);
+      break;
+    case PLAN_DOUBLE:
+      if (verbose) {
+        fprintf(stderr, "Doubling up from cached F(%ld)\n", base);
+      }
+      double_pair(fn, fn1, base, n);
+      break;
+    case PLAN_ADD:
+      if (verbose) {
+        fprintf(stderr, "Extending cached F(%ld) by F(%ld)\n", base, n - base);
+      }
+      add_pair(fn, fn1, base, n, verbose);
+      break;
+    case PLAN_FRESH:
+      if (verbose) {
+        fprintf(stderr, "No usable cache entry for F(%ld)\n", n);
+      }
+      if (algo == MATRIX) {
+        calculate_fibonacci_pair(fn, fn1, n, verbose);
+      } else {
+        mpz_set_ui(fn, 0);
+        mpz_set_ui(fn1, 1);
+        step_pair(fn, fn1, 0, n);
+      }
+      break;
+  }
+
+  // A cancelled calculation leaves garbage behind, which must not be published
+  if (!CALCULATION_CANCELLED()) {
+    store_pair(dir, n, fn, fn1, budget_bytes, verbose);
+  }
+  cache_lock_release(lock);
+  mpz_swap(result, fn);
+
+  mpz_clear(fn);
+  mpz_clear(fn1);
+  free(dir);
+  FIB_PROBE3(calc__done, "cached", n, (long) mpz_size(result));
+}
+
+int render_cache_open(long n, OutputFormat format, int raw_output, int verbose) {
+  char *dir = get_cache_directory();
+  if (dir == NULL) {
+    return -1;
+  }
+  char *path = render_path(dir, n, format, raw_output);
+  free(dir);
+  if (path == NULL) {
+    return -1;
+  }
+
+  int fd = open(path, O_RDONLY);
+  struct stat st;
+  if (fd != -1 && (fstat(fd, &st) != 0 || !S_ISREG(st.st_mode) || st.st_size == 0)) {
+    close(fd);
+    fd = -1;
+  }
+  if (fd != -1) {
+    futimens(fd, NULL);
+    if (verbose) {
+      fprintf(stderr, "Serving cached rendering %s\n", path);
+    }
+  }
+  free(path);
+  return fd;
+}
+
+/**
+ * Copies size bytes of in to the current position of out inside the kernel where possible:
+ * copy_file_range for regular files, sendfile for anything else, then plain reads and
+ * writes when neither applies (other systems, or file systems that refuse both).
+ */
+static int copy_descriptor(int in, int out, off_t size) {
+  off_t done = 0;
+#ifdef __linux__
+  int try_copy_range = 1;
+  int try_sendfile = 1;
+#endif
+  while (done < size) {
+    ssize_t copied;
+#ifdef __linux__
+    if (try_copy_range) {
+      loff_t offset = done;
+      copied = copy_file_range(in, &offset, out, NULL, (size_t) (size - done), 0);
+      if (copied < 0 && errno != EINTR) {
+        try_copy_range = 0;
+        continue;
+      }
+    } else if (try_sendfile) {
+      off_t offset = done;
+      copied = sendfile(out, in, &offset, (size_t) (size - done));
+      if (copied < 0 && errno != EINTR) {
+        try_sendfile = 0;
+        continue;
+      }
+    } else
+#endif
+    {
+      char buffer[65536];
+      size_t chunk = size - done < (off_t) sizeof(buffer) ? (size_t) (size - done) : sizeof(buffer);
+      copied = pread(in, buffer, chunk, done);
+      if (copied > 0 && write_all(out, buffer, (size_t) copied) != 0) {
+        return -1;
+      }
+    }
+    if (copied == 0 || (copied < 0 && errno != EINTR)) {
+      return -1;
+    }
+    if (copied > 0) {
+      done += copied;
+    }
+  }
+  return 0;
+}
+
+int render_cache_send(int fd, FILE *output, size_t digits_offset, char preview[65]) {
+  int status = -1;
+  struct stat st;
+  if (fflush(output) == 0 && fstat(fd, &st) == 0) {
+    // The history keeps the first digits, which sit right after the label
+    ssize_t got = pread(fd, preview, 64, (off_t) digits_offset);
+    preview[got > 0 ? got : 0] = '\0';
+    preview[strcspn(preview, "\n")] = '\0';
+    status = copy_descriptor(fd, fileno(output), st.st_size);
+  }
+  close(fd);
+  return status;
+}
+
+void render_cache_store(long n, OutputFormat format, int raw_output, const char *label,
+                        const char *digits, unsigned long long budget_bytes, int verbose) {
+  size_t label_len = strlen(label);
+  size_t digits_len = strlen(digits);
+  if (label_len + digits_len + 1 > budget_bytes) {
+    return;
+  }
+
+  char *dir = get_cache_directory();
+  if (dir == NULL) {
+    return;
+  }
+  char *path = render_path(dir, n, format, raw_output);
+  size_t tmp_len = strlen(dir) + 48;
+  char *tmp_path = malloc(tmp_len);
+  if (path == NULL || tmp_path == NULL) {
+    free(dir);
+    free(path);
+    free(tmp_path);
+    return;
+  }
+  snprintf(tmp_path, tmp_len, "%s/.render-%ld.XXXXXX", dir, n);
+
+  int fd = mkstemp(tmp_path);
+  if (fd != -1) {
+    int ok = write_all(fd, label, label_len) == 0 && write_all(fd, digits, digits_len) == 0 &&
+             write_all(fd, "\n", 1) == 0;
+    if (close(fd) != 0) {
+      ok = 0;
+    }
+    if (ok && rename(tmp_path, path) == 0) {
+      if (verbose) {
+        fprintf(stderr, "Cached rendering in %s\n", path);
+      }
+      enforce_budget(dir, budget_bytes, verbose);
+    } else {
+      unlink(tmp_path);
+    }
+  }
+
+  free(dir);
+  free(path);
+  free(tmp_path);
+}
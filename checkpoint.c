@@ -0,0 +1,261 @@
+#include "fib.h"
+#include "probes.h"
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#define CHECKPOINT_MAGIC "fib-checkpoint 1"
+
+// Hands snapshots of the ladder state to a thread that writes them out
+typedef struct {
+  pthread_mutex_t lock;
+  pthread_cond_t wake;
+  mpz_t fn;   // latest snapshot, guarded by lock
+  mpz_t fn1;
+  long k;     // index of the snapshot: fn = F(k), fn1 = F(k + 1)
+  int pending;
+  int done;
+  const char *path;
+  int verbose;
+} CheckpointWriter;
+
+/**
+ * Writes the state to a temporary file beside path, syncs it and renames it over path, so
+ * path always holds the last complete checkpoint.
+ *
+ * @return 0 on success, -1 on error
+ */
+static int write_checkpoint(const char *path, long k, const mpz_t fn, const mpz_t fn1) {
+  size_t len = strlen(path) + 8;
+  char *tmp_path = malloc(len);
+  if (tmp_path == NULL) {
+    return -1;
+  }
+  snprintf(tmp_path, len, "%s.XXXXXX", path);
+
+  int fd = mkstemp(tmp_path);
+  if (fd == -1) {
+    free(tmp_path);
+    return -1;
+  }
+  FILE *file = fdopen(fd, "wb");
+  if (file == NULL) {
+    close(fd);
+    unlink(tmp_path);
+    free(tmp_path);
+    return -1;
+  }
+
+  int ok = fprintf(file, CHECKPOINT_MAGIC " %ld\n", k) > 0 && mpz_out_raw(file, fn) > 0 &&
+           mpz_out_raw(file, fn1) > 0 && fflush(file) == 0 && fsync(fd) == 0;
+  if (fclose(file) != 0) {
+    ok = 0;
+  }
+  if (!ok || rename(tmp_path, path) != 0) {
+    unlink(tmp_path);
+    ok = 0;
+  }
+  free(tmp_path);
+  return ok ? 0 : -1;
+}
+
+static void *checkpoint_writer(void *arg) {
+  CheckpointWriter *writer = arg;
+  mpz_t fn, fn1;
+  mpz_init(fn);
+  mpz_init(fn1);
+
+  pthread_mutex_lock(&writer->lock);
+  for (;;) {
+    while (!writer->pending && !writer->done) {
+      pthread_cond_wait(&writer->wake, &writer->lock);
+    }
+    if (!writer->pending) {
+      break;
+    }
+    // Take the snapshot by swapping, then write it without holding the lock
+    mpz_swap(fn, writer->fn);
+    mpz_swap(fn1, writer->fn1);
+    long k = writer->k;
+    writer->pending = 0;
+    pthread_mutex_unlock(&writer->lock);
+
+    int status = write_checkpoint(writer->path, k, fn, fn1);
+    if (status != 0) {
+      fprintf(stderr, "Warning: Cannot write checkpoint '%s'\n", writer->path);
+    } else if (writer->verbose) {
+      fprintf(stderr, "Checkpointed F(%ld) to %s\n", k, writer->path);
+    }
+    pthread_mutex_lock(&writer->lock);
+  }
+  pthread_mutex_unlock(&writer->lock);
+
+  mpz_clear(fn);
+  mpz_clear(fn1);
+  return NULL;
+}
+
+/**
+ * Reads a checkpoint holding F(k) and F(k + 1).
+ *
+ * @return 0 on success, -1 if the file is missing or malformed
+ */
+static int read_checkpoint(const char *path, long *k, mpz_t fn, mpz_t fn1) {
+  FILE *file = fopen(path, "rb");
+  if (file == NULL) {
+    return -1;
+  }
+  char line[64];
+  int ok = fgets(line, sizeof(line), file) != NULL &&
+           sscanf(line, CHECKPOINT_MAGIC " %ld", k) == 1 && *k >= 0 &&
+           mpz_inp_raw(fn, file) > 0 && mpz_inp_raw(fn1, file) > 0;
+  fclose(file);
+  return ok ? 0 : -1;
+}
+
+/**
+ * Hands a copy of the ladder state at index k to the writer thread.
+ */
+static void post_snapshot(CheckpointWriter *writer, long k, const mpz_t fn, const mpz_t fn1) {
+  // Copying is a linear pass; the slow file write happens on the writer thread
+  pthread_mutex_lock(&writer->lock);
+  mpz_set(writer->fn, fn);
+  mpz_set(writer->fn1, fn1);
+  writer->k = k;
+  writer->pending = 1;
+  pthread_cond_signal(&writer->wake);
+  pthread_mutex_unlock(&writer->lock);
+}
+
+static double elapsed_seconds(const struct timespec *since) {
+  struct timespec now;
+  clock_gettime(CLOCK_MONOTONIC, &now);
+  return (double) (now.tv_sec - since->tv_sec) + (double) (now.tv_nsec - since->tv_nsec) / 1e9;
+}
+
+int calculate_fibonacci_checkpointed(mpz_t result, long n, const char *checkpoint_path,
+                                     double interval, const char *resume_path, int verbose) {
+  FIB_PROBE2(calc__start, "checkpoint", n);
+  if (n < 0) {
+    return -1;
+  }
+
+  mpz_t fn, fn1, even, odd;
+  mpz_init_set_ui(fn, 0);
+  mpz_init_set_ui(fn1, 1);
+  mpz_init(even);
+  mpz_init(odd);
+
+  // The ladder walks the bits of n from the top; after each step k is n with the low bits
+  // still to process shifted out, so any checkpoint whose k prefixes n is a valid start
+  int bit = (int) sizeof(long) * 8 - 1;
+  if (resume_path != NULL) {
+    long k;
+    if (read_checkpoint(resume_path, &k, fn, fn1) != 0) {
+      fprintf(stderr, "Error: Cannot read checkpoint '%s'\n", resume_path);
+      mpz_clear(fn);
+      mpz_clear(fn1);
+      mpz_clear(even);
+      mpz_clear(odd);
+      return -1;
+    }
+    bit = 0;
+    while (bit < (int) sizeof(long) * 8 - 1 && (n >> bit) > k) {
+      bit++;
+    }
+    if ((n >> bit) != k) {
+      fprintf(stderr, "Error: Checkpoint '%s' holds F(%ld), which is not on the path to F(%ld)\n",
+              resume_path, k, n);
+      mpz_clear(fn);
+      mpz_clear(fn1);
+      mpz_clear(even);
+      mpz_clear(odd);
+      return -1;
+    }
+    if (verbose) {
+      fprintf(stderr, "Resuming from F(%ld) with %d doubling steps left\n", k, bit);
+    }
+  }
+
+  CheckpointWriter writer;
+  pthread_t thread;
+  int writing = 0;
+  if (checkpoint_path != NULL) {
+    pthread_mutex_init(&writer.lock, NULL);
+    pthread_cond_init(&writer.wake, NULL);
+    mpz_init(writer.fn);
+    mpz_init(writer.fn1);
+    writer.k = 0;
+    writer.pending = 0;
+    writer.done = 0;
+    writer.path = checkpoint_path;
+    writer.verbose = verbose;
+    writing = pthread_create(&thread, NULL, checkpoint_writer, &writer) == 0;
+    if (!writing) {
+      fprintf(stderr, "Warning: Cannot start the checkpoint writer; continuing without it\n");
+    }
+  }
+
+  // Steps above the top bit of n would only double F(0)
+  while (bit > 0 && (n >> (bit - 1)) == 0) {
+    bit--;
+  }
+
+  struct timespec last_checkpoint;
+  clock_gettime(CLOCK_MONOTONIC, &last_checkpoint);
+  progress_begin("checkpointed doubling", "steps", bit, PROGRESS_DOUBLING);
+  for (bit--; bit >= 0 && !CALCULATION_CANCELLED(); bit--) {
+    double span = trace_begin();
+    // F(2k) = F(k) (2 F(k + 1) - F(k)),  F(2k + 1) = F(k)^2 + F(k + 1)^2
+    mpz_mul_2exp(even, fn1, 1);
+    mpz_sub(even, even, fn);
+    mpz_mul(even, even, fn);
+    mpz_mul(odd, fn, fn);
+    mpz_addmul(odd, fn1, fn1);
+    if ((n >> bit) & 1) {
+      mpz_add(fn1, even, odd);
+      mpz_swap(fn, odd);
+    } else {
+      mpz_swap(fn, even);
+      mpz_swap(fn1, odd);
+    }
+    trace_end("doubling_step", span, "k", n >> bit, "limbs", (long) mpz_size(fn1));
+    PROGRESS_ADVANCE();
+
+    if (writing && bit > 0 && elapsed_seconds(&last_checkpoint) >= interval) {
+      post_snapshot(&writer, n >> bit, fn, fn1);
+      clock_gettime(CLOCK_MONOTONIC, &last_checkpoint);
+    }
+  }
+  progress_end();
+
+  // A cancelled ladder stops between steps holding F(n >> (bit + 1)); save it for --resume
+  if (writing && bit >= 0) {
+    post_snapshot(&writer, n >> (bit + 1), fn, fn1);
+  }
+
+  if (writing) {
+    pthread_mutex_lock(&writer.lock);
+    writer.done = 1;
+    pthread_cond_signal(&writer.wake);
+    pthread_mutex_unlock(&writer.lock);
+    pthread_join(thread, NULL);
+  }
+  if (checkpoint_path != NULL) {
+    mpz_clear(writer.fn);
+    mpz_clear(writer.fn1);
+    pthread_cond_destroy(&writer.wake);
+    pthread_mutex_destroy(&writer.lock);
+  }
+
+  mpz_swap(result, fn);
+  mpz_clear(fn);
+  mpz_clear(fn1);
+  mpz_clear(even);
+  mpz_clear(odd);
+  FIB_PROBE3(calc__done, "checkpoint", n, (long) mpz_size(result));
+  return 0;
+}
@@ -0,0 +1,470 @@
+#include "fib.h"
+#include "probes.h"
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+// Digits per leaf of the decimal conversion; small enough to stay in L1 while hashing
+#define STREAM_LEAF_DIGITS 4096
+#define STREAM_MAX_LEVELS 64
+
+typedef struct {
+  uint32_t state[8];
+  uint64_t length;
+  unsigned char block[64];
+  size_t used;
+} Sha256;
+
+typedef struct {
+  uint64_t lanes[4];
+  uint64_t length;
+  unsigned char stripe[32];
+  size_t used;
+} Xxh64;
+
+struct DigitSink {
+  DigestKind digest;
+  int count_digits;
+  int alphabet;
+  Sha256 sha256;
+  Xxh64 xxh64;
+  unsigned long long counts[16];
+  FILE *echo;  // also receives every digit when set
+  int echo_failed;
+  char head[65];  // first digits, for the history preview
+  size_t head_len;
+};
+
+// SHA-256 (FIPS 180-4)
+
+static const uint32_t sha256_k[64] = {
+    0x428a2f98, 0x71374491, 0xb5c0fbcf, 0xe9b5dba5, 0x3956c25b, 0x59f111f1, 0x923f82a4,
+    0xab1c5ed5, 0xd807aa98, 0x12835b01, 0x243185be, 0x550c7dc3, 0x72be5d74, 0x80deb1fe,
+    0x9bdc06a7, 0xc19bf174, 0xe49b69c1, 0xefbe4786, 0x0fc19dc6, 0x240ca1cc, 0x2de92c6f,
+    0x4a7484aa, 0x5cb0a9dc, 0x76f988da, 0x983e5152, 0xa831c66d, 0xb00327c8, 0xbf597fc7,
+    0xc6e00bf3, 0xd5a79147, 0x06ca6351, 0x14292967, 0x27b70a85, 0x2e1b2138, 0x4d2c6dfc,
+    0x53380d13, 0x650a7354, 0x766a0abb, 0x81c2c92e, 0x92722c85, 0xa2bfe8a1, 0xa81a664b,
+    0xc24b8b70, 0xc76c51a3, 0xd192e819, 0xd6990624, 0xf40e3585, 0x106aa070, 0x19a4c116,
+    0x1e376c08, 0x2748774c, 0x34b0bcb5, 0x391c0cb3, 0x4ed8aa4a, 0x5b9cca4f, 0x682e6ff3,
+    0x748f82ee, 0x78a5636f, 0x84c87814, 0x8cc70208, 0x90befffa, 0xa4506ceb, 0xbef9a3f7,
+    0xc67178f2};
+
+static uint32_t rotr32(uint32_t x, int n) {
+  return (x >> n) | (x << (32 - n));
+}
+
+static void sha256_init(Sha256 *ctx) {
+  static const uint32_t initial[8] = {0x6a09e667, 0xbb67ae85, 0x3c6ef372, 0xa54ff53a,
+                                      0x510e527f, 0x9b05688c, 0x1f83d9ab, 0x5be0cd19};
+  memcpy(ctx->state, initial, sizeof(initial));
+  ctx->length = 0;
+  ctx->used = 0;
+}
+
+static void sha256_compress(Sha256 *ctx, const unsigned char *block) {
+  uint32_t w[64];
+  for (int i = 0; i < 16; i++) {
+    w[i] = (uint32_t) block[4 * i] << 24 | (uint32_t) block[4 * i + 1] << 16 |
+           (uint32_t) block[4 * i + 2] << 8 | (uint32_t) block[4 * i + 3];
+  }
+  for (int i = 16; i < 64; i++) {
+    uint32_t s0 = rotr32(w[i - 15], 7) ^ rotr32(w[i - 15], 18) ^ (w[i - 15] >> 3);
+    uint32_t s1 = rotr32(w[i - 2], 17) ^ rotr32(w[i - 2], 19) ^ (w[i - 2] >> 10);
+    w[i] = w[i - 16] + s0 + w[i - 7] + s1;
+  }
+
+  uint32_t a = ctx->state[0], b = ctx->state[1], c = ctx->state[2], d = ctx->state[3];
+  uint32_t e = ctx->state[4], f = ctx->state[5], g = ctx->state[6], h = ctx->state[7];
+  for (int i = 0; i < 64; i++) {
+    uint32_t t1 = h + (rotr32(e, 6) ^ rotr32(e, 11) ^ rotr32(e, 25)) + ((e & f) ^ (~e & g)) +
+                  sha256_k[i] + w[i];
+    uint32_t t2 = (rotr32(a, 2) ^ rotr32(a, 13) ^ rotr32(a, 22)) + ((a & b) ^ (a & c) ^ (b & c));
+    h = g;
+    g = f;
+    f = e;
+    e = d + t1;
+    d = c;
+    c = b;
+    b = a;
+    a = t1 + t2;
+  }
+
+  ctx->state[0] += a;
+  ctx->state[1] += b;
+  ctx->state[2] += c;
+  ctx->state[3] += d;
+  ctx->state[4] += e;
+  ctx->state[5] += f;
+  ctx->state[6] += g;
+  ctx->state[7] += h;
+}
+
+static void sha256_update(Sha256 *ctx, const unsigned char *data, size_t len) {
+  ctx->length += len;
+  if (ctx->used > 0) {
+    size_t take = 64 - ctx->used < len ? 64 - ctx->used : len;
+    memcpy(ctx->block + ctx->used, data, take);
+    ctx->used += take;
+    data += take;
+    len -= take;
+    if (ctx->used < 64) {
+      return;
+    }
+    sha256_compress(ctx, ctx->block);
+    ctx->used = 0;
+  }
+  for (; len >= 64; data += 64, len -= 64) {
+    sha256_compress(ctx, data);
+  }
+  memcpy(ctx->block, data, len);
+  ctx->used = len;
+}
+
+static void sha256_final(Sha256 *ctx, unsigned char digest[32]) {
+  uint64_t bits = ctx->length * 8;
+  unsigned char pad[72] = {0x80};
+  size_t pad_len = (ctx->used < 56 ? 56 : 120) - ctx->used;
+  for (int i = 0; i < 8; i++) {
+    pad[pad_len + (size_t) i] = (unsigned char) (bits >> (56 - 8 * i));
+  }
+  sha256_update(ctx, pad, pad_len + 8);
+
+  for (int i = 0; i < 8; i++) {
+    digest[4 * i] = (unsigned char) (ctx->state[i] >> 24);
+    digest[4 * i + 1] = (unsigned char) (ctx->state[i] >> 16);
+    digest[4 * i + 2] = (unsigned char) (ctx->state[i] >> 8);
+    digest[4 * i + 3] = (unsigned char) ctx->state[i];
+  }
+}
+
+// XXH64 with seed 0
+
+static const uint64_t xxh_prime1 = 0x9E3779B185EBCA87ULL;
+static const uint64_t xxh_prime2 = 0xC2B2AE3D27D4EB4FULL;
+static const uint64_t xxh_prime3 = 0x165667B19E3779F9ULL;
+static const uint64_t xxh_prime4 = 0x85EBCA77C2B2AE63ULL;
+static const uint64_t xxh_prime5 = 0x27D4EB2F165667C5ULL;
+
+static uint64_t rotl64(uint64_t x, int n) {
+  return (x << n) | (x >> (64 - n));
+}
+
+static uint64_t read_le64(const unsigned char *p) {
+  uint64_t value = 0;
+  for (int i = 7; i >= 0; i--) {
+    value = value << 8 | p[i];
+  }
+  return value;
+}
+
+static uint64_t xxh64_round(uint64_t acc, uint64_t input) {
+  return rotl64(acc + input * xxh_prime2, 31) * xxh_prime1;
+}
+
+static void xxh64_init(Xxh64 *ctx) {
+  ctx->lanes[0] = xxh_prime1 + xxh_prime2;
+  ctx->lanes[1] = xxh_prime2;
+  ctx->lanes[2] = 0;
+  ctx->lanes[3] = 0 - xxh_prime1;
+  ctx->length = 0;
+  ctx->used = 0;
+}
+
+static void xxh64_stripe(Xxh64 *ctx, const unsigned char *stripe) {
+  for (int i = 0; i < 4; i++) {
+    ctx->lanes[i] = xxh64_round(ctx->lanes[i], read_le64(stripe + 8 * i));
+  }
+}
+
+static void xxh64_update(Xxh64 *ctx, const unsigned char *data, size_t len) {
+  ctx->length += len;
+  if (ctx->used > 0) {
+    size_t take = 32 - ctx->used < len ? 32 - ctx->used : len;
+    memcpy(ctx->stripe + ctx->used, data, take);
+    ctx->used += take;
+    data += take;
+    len -= take;
+    if (ctx->used < 32) {
+      return;
+    }
+    xxh64_stripe(ctx, ctx->stripe);
+    ctx->used = 0;
+  }
+  for (; len >= 32; data += 32, len -= 32) {
+    xxh64_stripe(ctx, data);
+  }
+  memcpy(ctx->stripe, data, len);
+  ctx->used = len;
+}
+
+static uint64_t xxh64_final(const Xxh64 *ctx) {
+  uint64_t h;
+  if (ctx->length >= 32) {
+    h = rotl64(ctx->lanes[0], 1) + rotl64(ctx->lanes[1], 7) + rotl64(ctx->lanes[2], 12) +
+        rotl64(ctx->lanes[3], 18);
+    for (int i = 0; i < 4; i++) {
+      h = (h ^ xxh64_round(0, ctx->lanes[i])) * xxh_prime1 + xxh_prime4;
+    }
+  } else {
+    h = xxh_prime5;
+  }
+  h += ctx->length;
+
+  const unsigned char *p = ctx->stripe;
+  size_t left = ctx->used;
+  for (; left >= 8; p += 8, left -= 8) {
+    h = rotl64(h ^ xxh64_round(0, read_le64(p)), 27) * xxh_prime1 + xxh_prime4;
+  }
+  if (left >= 4) {
+    uint64_t word = (uint64_t) p[0] | (uint64_t) p[1] << 8 | (uint64_t) p[2] << 16 |
+                    (uint64_t) p[3] << 24;
+    h = rotl64(h ^ (word * xxh_prime1), 23) * xxh_prime2 + xxh_prime3;
+    p += 4;
+    left -= 4;
+  }
+  for (; left > 0; p++, left--) {
+    h = rotl64(h ^ (*p * xxh_prime5), 11) * xxh_prime1;
+  }
+
+  h ^= h >> 33;
+  h *= xxh_prime2;
+  h ^= h >> 29;
+  h *= xxh_prime3;
+  h ^= h >> 32;
+  return h;
+}
+
+unsigned long long digest_xxh64(const void *data, size_t len) {
+  Xxh64 ctx;
+  xxh64_init(&ctx);
+  xxh64_update(&ctx, data, len);
+  return xxh64_final(&ctx);
+}
+
+// Digit histogram
+
+/**
+ * Adds the occurrences of each symbol in chunk to counts. One pass per symbol of a
+ * compare-and-add loop over a cache-resident chunk: the loop body has no table lookups or
+ * stores, so the compiler emits packed byte compares instead of a scalar histogram.
+ */
+static void count_symbols(unsigned long long counts[16], const char *chunk, size_t len,
+                          int alphabet) {
+  static const char symbols[] = "0123456789abcdef";
+  for (int s = 0; s < alphabet; s++) {
+    const char symbol = symbols[s];
+    unsigned int count = 0;
+    for (size_t i = 0; i < len; i++) {
+      count += chunk[i] == symbol;
+    }
+    counts[s] += count;
+  }
+}
+
+DigitSink *digit_sink_create(DigestKind digest, int count_digits, OutputFormat format) {
+  DigitSink *sink = calloc(1, sizeof(DigitSink));
+  if (sink == NULL) {
+    return NULL;
+  }
+  sink->digest = digest;
+  sink->count_digits = count_digits;
+  sink->alphabet = format == HEXADECIMAL ? 16 : (format == BINARY ? 2 : 10);
+  sha256_init(&sink->sha256);
+  xxh64_init(&sink->xxh64);
+  return sink;
+}
+
+void digit_sink_free(DigitSink *sink) {
+  free(sink);
+}
+
+void digit_sink_tee(DigitSink *sink, FILE *output) {
+  sink->echo = output;
+}
+
+const char *digit_sink_head(const DigitSink *sink) {
+  return sink->head;
+}
+
+void digit_sink_update(DigitSink *sink, const char *digits, size_t len) {
+  if (sink->echo != NULL) {
+    double span = trace_begin();
+    if (fwrite(digits, 1, len, sink->echo) != len) {
+      sink->echo_failed = 1;
+    }
+    FIB_PROBE1(output__write, (long) len);
+    trace_end("output_chunk", span, "bytes", (long) len, NULL, 0);
+  }
+  if (sink->head_len < sizeof(sink->head) - 1) {
+    size_t take = sizeof(sink->head) - 1 - sink->head_len;
+    take = take < len ? take : len;
+    memcpy(sink->head + sink->head_len, digits, take);
+    sink->head_len += take;
+  }
+
+  // Keep histogram chunks small enough that each symbol pass hits L1
+  while (len > 0) {
+    size_t chunk = len < STREAM_LEAF_DIGITS ? len : STREAM_LEAF_DIGITS;
+    if (sink->digest == DIGEST_SHA256) {
+      sha256_update(&sink->sha256, (const unsigned char *) digits, chunk);
+    } else if (sink->digest == DIGEST_XXH64) {
+      xxh64_update(&sink->xxh64, (const unsigned char *) digits, chunk);
+    }
+    if (sink->count_digits) {
+      count_symbols(sink->counts, digits, chunk, sink->alphabet);
+    }
+    digits += chunk;
+    len -= chunk;
+  }
+}
+
+/**
+ * Feeds the decimal digits of value (< powers[level]^2) to the sink, most significant first.
+ * Splitting by 10^(STREAM_LEAF_DIGITS * 2^level) converts in O(M(n) log n) like mpz_get_str,
+ * but only one leaf of text exists at a time. Pieces below the top are zero-padded.
+ */
+static void stream_decimal(DigitSink *sink, const mpz_t value, mpz_t *powers, int level,
+                           size_t width, char *buffer) {
+  if (level < 0) {
+    mpz_get_str(buffer, 10, value);
+    size_t len = strlen(buffer);
+    if (width > len) {
+      memmove(buffer + width - len, buffer, len + 1);
+      memset(buffer, '0', width - len);
+      len = width;
+    }
+    digit_sink_update(sink, buffer, len);
+    return;
+  }
+
+  double span = trace_begin();
+  mpz_t high, low;
+  mpz_init(high);
+  mpz_init(low);
+  mpz_tdiv_qr(high, low, value, powers[level]);
+
+  size_t half = (size_t) STREAM_LEAF_DIGITS << level;
+  if (width > 0 || mpz_sgn(high) != 0) {
+    stream_decimal(sink, high, powers, level - 1, width > 0 ? width - half : 0, buffer);
+    mpz_clear(high);
+    stream_decimal(sink, low, powers, level - 1, half, buffer);
+  } else {
+    mpz_clear(high);
+    stream_decimal(sink, low, powers, level - 1, 0, buffer);
+  }
+  mpz_clear(low);
+  trace_end("convert_subtree", span, "level", level, "limbs", (long) mpz_size(value));
+}
+
+/**
+ * Feeds hexadecimal or binary digits straight from the limbs, most significant first.
+ */
+static void stream_power_of_two(DigitSink *sink, const mpz_t value, int digit_bits,
+                                char *buffer) {
+  static const char symbols[] = "0123456789abcdef";
+  const mp_limb_t *limbs = mpz_limbs_read(value);
+  size_t used = 0;
+  size_t total_bits = mpz_sizeinbase(value, 2);
+  size_t digits = (total_bits + (size_t) digit_bits - 1) / (size_t) digit_bits;
+  unsigned mask = (1u << digit_bits) - 1;
+
+  for (size_t d = digits; d-- > 0;) {
+    size_t bit = d * (size_t) digit_bits;
+    mp_limb_t limb = limbs[bit / GMP_NUMB_BITS];
+    buffer[used++] = symbols[(limb >> (bit % GMP_NUMB_BITS)) & mask];
+    if (used == STREAM_LEAF_DIGITS) {
+      digit_sink_update(sink, buffer, used);
+      used = 0;
+    }
+  }
+  if (used > 0) {
+    digit_sink_update(sink, buffer, used);
+  }
+}
+
+int digit_sink_stream(DigitSink *sink, const mpz_t value, int verbose) {
+  char *buffer = malloc(STREAM_LEAF_DIGITS + 2);
+  if (buffer == NULL) {
+    return -1;
+  }
+
+  // Read-only alias of |value| over the same limbs, so no copy of the value is made
+  mpz_t magnitude;
+  mpz_roinit_n(magnitude, mpz_limbs_read(value), (mp_size_t) mpz_size(value));
+
+  if (mpz_sgn(magnitude) == 0) {
+    digit_sink_update(sink, "0", 1);
+  } else if (sink->alphabet != 10) {
+    stream_power_of_two(sink, magnitude, sink->alphabet == 16 ? 4 : 1, buffer);
+  } else {
+    // powers[i] = 10^(STREAM_LEAF_DIGITS * 2^i), up to about half the size of the value
+    mpz_t powers[STREAM_MAX_LEVELS];
+    int levels = 0;
+    mpz_init(powers[0]);
+    mpz_ui_pow_ui(powers[0], 10, STREAM_LEAF_DIGITS);
+    levels = 1;
+    while (levels < STREAM_MAX_LEVELS &&
+           mpz_sizeinbase(powers[levels - 1], 2) * 2 <= mpz_sizeinbase(magnitude, 2) + 1) {
+      mpz_init(powers[levels]);
+      mpz_mul(powers[levels], powers[levels - 1], powers[levels - 1]);
+      levels++;
+    }
+    if (verbose) {
+      fprintf(stderr, "Streaming decimal digits through %d levels of %d-digit leaves\n", levels,
+              STREAM_LEAF_DIGITS);
+    }
+
+    // value < powers[levels - 1]^2 holds because the last power exceeds sqrt(value)
+    stream_decimal(sink, magnitude, powers, levels - 1, 0, buffer);
+    for (int i = 0; i < levels; i++) {
+      mpz_clear(powers[i]);
+    }
+  }
+
+  free(buffer);
+  return sink->echo_failed ? -1 : 0;
+}
+
+int digit_sink_report(DigitSink *sink, FILE *output, int raw_output) {
+  if (sink->digest != DIGEST_NONE) {
+    char hex[65];
+    if (sink->digest == DIGEST_SHA256) {
+      unsigned char digest[32];
+      sha256_final(&sink->sha256, digest);
+      for (int i = 0; i < 32; i++) {
+        snprintf(hex + 2 * i, 3, "%02x", digest[i]);
+      }
+    } else {
+      snprintf(hex, sizeof(hex), "%016llx", (unsigned long long) xxh64_final(&sink->xxh64));
+    }
+
+    const char *name = sink->digest == DIGEST_SHA256 ? "SHA-256" : "XXH64";
+    int written = raw_output ? fprintf(output, "%s\n", hex)
+                             : fprintf(output, "Digest (%s): %s\n", name, hex);
+    if (written < 0) {
+      return -1;
+    }
+  }
+
+  if (sink->count_digits) {
+    static const char symbols[] = "0123456789abcdef";
+    unsigned long long total = 0;
+
+    if (!raw_output && fprintf(output, "Digit Counts:") < 0) {
+      return -1;
+    }
+    for (int s = 0; s < sink->alphabet; s++) {
+      total += sink->counts[s];
+      int written = raw_output ? fprintf(output, s == 0 ? "%llu" : " %llu", sink->counts[s])
+                               : fprintf(output, " %c=%llu", symbols[s], sink->counts[s]);
+      if (written < 0) {
+        return -1;
+      }
+    }
+    if ((raw_output ? fprintf(output, "\n") : fprintf(output, " (total %llu)\n", total)) < 0) {
+      return -1;
+    }
+  }
+  return 0;
+}
@@ -0,0 +1,141 @@
+#include "fib.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+// Cache of base^(2^i), built by repeated squaring and shared by every power we need
+#define POWER_CACHE_SIZE 64
+
+typedef struct {
+  mpz_t powers[POWER_CACHE_SIZE];
+  int count;
+} PowerCache;
+
+static void power_cache_init(PowerCache *cache, unsigned long base) {
+  mpz_init_set_ui(cache->powers[0], base);
+  cache->count = 1;
+}
+
+static void power_cache_clear(PowerCache *cache) {
+  for (int i = 0; i < cache->count; i++) {
+    mpz_clear(cache->powers[i]);
+  }
+  cache->count = 0;
+}
+
+/**
+ * Sets result = base^exponent as a product of cached base^(2^i) entries.
+ */
+static void power_cache_pow(mpz_t result, PowerCache *cache, unsigned long exponent) {
+  mpz_set_ui(result, 1);
+  for (int i = 0; exponent != 0 && i < POWER_CACHE_SIZE; i++, exponent >>= 1) {
+    if (i == cache->count) {
+      mpz_init(cache->powers[i]);
+      mpz_mul(cache->powers[i], cache->powers[i - 1], cache->powers[i - 1]);
+      cache->count++;
+    }
+    if (exponent & 1) {
+      mpz_mul(result, result, cache->powers[i]);
+    }
+  }
+}
+
+/**
+ * Renders window as exactly width digits in the given base, padding with leading zeros.
+ */
+static char *render_padded(const mpz_t window, int base, size_t width) {
+  char *digits = mpz_get_str(NULL, base, window);
+  if (digits == NULL) {
+    return NULL;
+  }
+
+  size_t len = strlen(digits);
+  char *padded = malloc(width + 1);
+  if (padded != NULL && len <= width) {
+    memset(padded, '0', width - len);
+    memcpy(padded + width - len, digits, len + 1);
+  } else {
+    free(padded);
+    padded = NULL;
+  }
+
+  void (*free_func)(void *, size_t);
+  mp_get_memory_functions(NULL, NULL, &free_func);
+  free_func(digits, len + 1);
+  return padded;
+}
+
+/**
+ * Extracts a window of a power-of-two base representation straight from the limbs,
+ * without shifting or copying the rest of the number.
+ */
+static void extract_bit_window(mpz_t window, const mpz_t value, mp_bitcnt_t bit_offset,
+                               mp_bitcnt_t bit_count) {
+  size_t limbs = mpz_size(value);
+  size_t first = bit_offset / GMP_NUMB_BITS;
+  size_t last = (bit_offset + bit_count - 1) / GMP_NUMB_BITS;
+  if (last >= limbs) {
+    last = limbs - 1;
+  }
+
+  mpz_t view;
+  mpz_roinit_n(view, mpz_limbs_read(value) + first, (mp_size_t) (last - first + 1));
+  mpz_tdiv_q_2exp(window, view, bit_offset % GMP_NUMB_BITS);
+  mpz_tdiv_r_2exp(window, window, bit_count);
+}
+
+char *fibonacci_digit_window(mpz_t value, long n, unsigned long pos, unsigned long len,
+                             OutputFormat format, int verbose) {
+  if (len == 0 || mpz_sgn(value) < 0) {
+    return NULL;
+  }
+
+  int base = format == HEXADECIMAL ? 16 : (format == BINARY ? 2 : 10);
+  size_t total;
+  if (base == 10) {
+    // Exact decimal size without converting or building 10^digits
+    if (fibonacci_digit_count(&total, n, 10, 0) != 0) {
+      return NULL;
+    }
+  } else {
+    total = mpz_sizeinbase(value, base);
+  }
+
+  if (pos >= total) {
+    fprintf(stderr, "Error: Digit position %lu is beyond the %zu digits of the result\n", pos,
+            total);
+    return NULL;
+  }
+
+  size_t width = total - pos < len ? total - pos : len;
+  if (verbose) {
+    fprintf(stderr, "Extracting %zu of %zu digits starting at position %lu\n", width, total, pos);
+  }
+
+  mpz_t window;
+  mpz_init(window);
+
+  if (base == 10) {
+    // floor(value / 10^pos) mod 10^width
+    PowerCache cache;
+    power_cache_init(&cache, 10);
+
+    mpz_t power;
+    mpz_init(power);
+    power_cache_pow(power, &cache, pos);
+    mpz_tdiv_q(window, value, power);
+    power_cache_pow(power, &cache, (unsigned long) width);
+    mpz_tdiv_r(window, window, power);
+
+    mpz_clear(power);
+    power_cache_clear(&cache);
+  } else {
+    mp_bitcnt_t digit_bits = base == 16 ? 4 : 1;
+    extract_bit_window(window, value, (mp_bitcnt_t) pos * digit_bits,
+                       (mp_bitcnt_t) width * digit_bits);
+  }
+
+  char *result = render_padded(window, base, width);
+  mpz_clear(window);
+  return result;
+}
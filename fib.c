@@ -9,6 +9,7 @@
 #endif
 
 #include "fib.h"
+#include "probes.h"
 #include <errno.h>
 #include <fcntl.h>
 #include <limits.h>
@@ -19,6 +20,18 @@
 #include <time.h>
 #include <unistd.h>
 
+// Default size budget of the pair cache enabled by --cache, in MiB
+#define DEFAULT_CACHE_MIB 256
+
+// Default time between checkpoints written by --checkpoint, in seconds
+#define DEFAULT_CHECKPOINT_INTERVAL 60.0
+
+// Default resident budget of the mappings used by --out-of-core, in MiB
+#define DEFAULT_RESIDENT_MIB 1024
+
+// Exit status when --timeout expires, as timeout(1) uses
+#define EXIT_TIMEOUT 124
+
 // Define O_NOFOLLOW if not available (for security)
 #ifndef O_NOFOLLOW
 #define O_NOFOLLOW 0
@@ -264,12 +277,539 @@ static char *validate_output_path(const char *path) {
 }
 
 static void cleanup_resources(char *output_file, int free_args, int argc, char **argv) {
+  progress_stop_reporter();
   free(output_file);
   if (free_args) {
     free_generated_args(argc, argv);
   }
 }
 
+/**
+ * Opens the output destination: the validated output file, or stdout if none was given.
+ *
+ * @param output_file Path previously returned by validate_output_path(), or NULL
+ * @param verbose Whether to report progress on stderr
+ * @return The stream to write to, or NULL on error
+ */
+static FILE *open_output_stream(const char *output_file, int verbose) {
+  if (output_file == NULL) {
+    return stdout;
+  }
+
+  if (verbose) {
+    fprintf(stderr, "Opening output file: %s\n", output_file);
+  }
+
+  // SECURITY: output_file has been fully sanitized by validate_output_path()
+  // The function breaks the taint chain by:
+  // 1. Sanitizing the filename to contain only safe characters (alphanumeric, -, _, .)
+  // 2. Resolving directory to canonical path via realpath()
+  // 3. Verifying the directory is in a safe location whitelist
+  // 4. Constructing a new path string from validated components
+  // This eliminates path traversal (CWE-22) and tainted path (CWE-73) vulnerabilities
+
+  // Use open() with O_CREAT | O_NOFOLLOW to safely create the file
+  // O_NOFOLLOW prevents following symlinks, mitigating TOCTOU attacks
+  int fd = open(output_file, O_WRONLY | O_CREAT | O_TRUNC | O_NOFOLLOW, 0644);
+  if (fd == -1) {
+    perror("Error opening output file");
+    return NULL;
+  }
+
+  // Convert file descriptor to FILE* stream
+  FILE *output = fdopen(fd, "w");
+  if (output == NULL) {
+    perror("Error creating file stream");
+    close(fd);
+    return NULL;
+  }
+
+  return output;
+}
+
+/**
+ * Closes a stream returned by open_output_stream(), or flushes it if it is stdout.
+ *
+ * @return 0 on success, -1 on error
+ */
+static int close_output_stream(FILE *output, int verbose) {
+  if (output != stdout) {
+    if (verbose) {
+      fprintf(stderr, "Closing output file\n");
+    }
+
+    if (fclose(output) != 0) {
+      perror("Error closing output file");
+      return -1;
+    }
+  }
+  // Flush stdout to ensure all output is written
+  else if (fflush(stdout) == EOF) {
+    return -1;
+  }
+
+  return 0;
+}
+
+static const char *format_display_name(OutputFormat format) {
+  switch (format) {
+    case HEXADECIMAL:
+      return "hexadecimal";
+    case BINARY:
+      return "binary";
+    default:
+      return "decimal";
+  }
+}
+
+static int format_base(OutputFormat format) {
+  switch (format) {
+    case HEXADECIMAL:
+      return 16;
+    case BINARY:
+      return 2;
+    default:
+      return 10;
+  }
+}
+
+/**
+ * Formats what precedes the digits of a full result: the label, or in raw mode only the
+ * sign and the prefix of non-decimal formats.
+ */
+static void format_result_label(char *label, size_t size, const char *sequence_label, long n,
+                                OutputFormat format, int raw_output, const char *sign) {
+  const char *prefix = format != DECIMAL ? get_format_prefix(format) : "";
+  if (raw_output) {
+    snprintf(label, size, "%s%s", sign, prefix);
+  } else {
+    snprintf(label, size, "%s %ld (%s): %s%s", sequence_label, n, format_display_name(format),
+             sign, prefix);
+  }
+}
+
+/**
+ * Writes F(n) from the rendered-output cache, copying the entry to the output inside the
+ * kernel without computing or converting F(n).
+ *
+ * @return EXIT_SUCCESS or EXIT_FAILURE once answered, or -1 if there is no cached rendering
+ */
+static int run_cached_rendering(long n, Algorithm algo, OutputFormat format, int raw_output,
+                                int show_time, const char *output_file, int verbose) {
+  int fd = render_cache_open(n, format, raw_output, verbose);
+  if (fd == -1) {
+    return -1;
+  }
+
+  FILE *output = open_output_stream(output_file, verbose);
+  if (output == NULL) {
+    close(fd);
+    return EXIT_FAILURE;
+  }
+
+  char label[256];
+  format_result_label(label, sizeof(label), "Fibonacci Number", n, format, raw_output, "");
+  char preview[65];
+  double start_time = monotonic_seconds();
+  int status = render_cache_send(fd, output, strlen(label), preview);
+  const double time_taken = monotonic_seconds() - start_time;
+
+  if (status == 0 && show_time) {
+    status = fprintf(output, "Calculation Time: %lf seconds\n", time_taken) < 0 ? -1 : 0;
+  }
+  if (close_output_stream(output, verbose) != 0) {
+    status = -1;
+  }
+  if (status == 0) {
+    add_to_history(n, algo, format, time_taken, preview);
+  }
+  return status < 0 ? EXIT_FAILURE : EXIT_SUCCESS;
+}
+
+/**
+ * Prints the leading k digits of F(n) without computing the full number.
+ *
+ * @return EXIT_SUCCESS or EXIT_FAILURE
+ */
+static int run_leading_digits(long n, unsigned long k, OutputFormat format, int raw_output,
+                              int show_time, FILE *output, int verbose) {
+  mpz_t leading;
+  mpz_init(leading);
+  size_t digit_count = 0;
+
+  const double start_time = monotonic_seconds();
+  if (fibonacci_leading_digits(leading, &digit_count, n, k, format_base(format), verbose) != 0) {
+    fprintf(stderr, "Error: Cannot compute leading digits of F(%ld)\n", n);
+    mpz_clear(leading);
+    return EXIT_FAILURE;
+  }
+  const double end_time = monotonic_seconds();
+  if (CALCULATION_CANCELLED()) {
+    mpz_clear(leading);
+    return EXIT_TIMEOUT;
+  }
+
+  char *digits = get_formatted_result(leading, format, verbose);
+  if (digits == NULL) {
+    mpz_clear(leading);
+    return EXIT_FAILURE;
+  }
+
+  int written;
+  if (raw_output) {
+    written = fprintf(output, "%s%s\n", get_format_prefix(format), digits);
+  } else {
+    written = fprintf(output, "Fibonacci Number %ld (first %zu of %zu %s digits): %s%s\n", n,
+                      strlen(digits), digit_count, format_display_name(format),
+                      get_format_prefix(format), digits);
+  }
+
+  if (written >= 0 && show_time) {
+    const double time_taken = end_time - start_time;
+    written = fprintf(output, "Calculation Time: %lf seconds\n", time_taken);
+  }
+
+  free(digits);
+  mpz_clear(leading);
+  return written < 0 ? EXIT_FAILURE : EXIT_SUCCESS;
+}
+
+/**
+ * Prints the number of digits of F(n) in the given format (bits for binary) without
+ * computing F(n).
+ *
+ * @return EXIT_SUCCESS or EXIT_FAILURE
+ */
+static int run_digit_count(long n, OutputFormat format, int raw_output, int show_time,
+                           FILE *output, int verbose) {
+  size_t digit_count = 0;
+
+  const double start_time = monotonic_seconds();
+  if (fibonacci_digit_count(&digit_count, n, format_base(format), verbose) != 0) {
+    fprintf(stderr, "Error: Cannot compute the size of F(%ld)\n", n);
+    return EXIT_FAILURE;
+  }
+  const double end_time = monotonic_seconds();
+  if (CALCULATION_CANCELLED()) {
+    return EXIT_TIMEOUT;
+  }
+
+  int written;
+  if (raw_output) {
+    written = fprintf(output, "%zu\n", digit_count);
+  } else if (format == BINARY) {
+    written = fprintf(output, "Fibonacci Number %ld has %zu bits\n", n, digit_count);
+  } else {
+    written = fprintf(output, "Fibonacci Number %ld has %zu %s digits\n", n, digit_count,
+                      format_display_name(format));
+  }
+
+  if (written >= 0 && show_time) {
+    const double time_taken = end_time - start_time;
+    written = fprintf(output, "Calculation Time: %lf seconds\n", time_taken);
+  }
+
+  return written < 0 ? EXIT_FAILURE : EXIT_SUCCESS;
+}
+
+/**
+ * Reads a value and prints its Fibonacci index, or reports that it is not a Fibonacci number.
+ *
+ * @return EXIT_SUCCESS or EXIT_FAILURE
+ */
+static int run_index_of(const char *spec, int raw_output, int show_time, FILE *output,
+                        int verbose) {
+  mpz_t value;
+  mpz_init(value);
+
+  if (read_big_integer(value, spec) != 0) {
+    fprintf(stderr, "Error: Cannot parse '%s' as a non-negative integer\n", spec);
+    mpz_clear(value);
+    return EXIT_FAILURE;
+  }
+
+  const double start_time = monotonic_seconds();
+  // A few GMP calls without a loop to poll in; a deadline that passed meanwhile still counts
+  long index = fibonacci_index_of(value, verbose);
+  const double end_time = monotonic_seconds();
+  if (CALCULATION_CANCELLED()) {
+    mpz_clear(value);
+    return EXIT_TIMEOUT;
+  }
+
+  int written;
+  if (index < 0) {
+    written = fprintf(output, "%s\n", raw_output ? "not Fibonacci" : "Value is not Fibonacci");
+  } else if (raw_output) {
+    written = fprintf(output, "%ld\n", index);
+  } else {
+    written = fprintf(output, "Fibonacci Index: %ld\n", index);
+  }
+
+  if (written >= 0 && show_time) {
+    const double time_taken = end_time - start_time;
+    written = fprintf(output, "Calculation Time: %lf seconds\n", time_taken);
+  }
+
+  mpz_clear(value);
+  return written < 0 ? EXIT_FAILURE : EXIT_SUCCESS;
+}
+
+/**
+ * Parses an index range given as "b" (meaning 0:b) or "a:b" with 0 <= a <= b.
+ *
+ * @return 0 on success, -1 if the range is malformed
+ */
+static int parse_index_range(const char *arg, long *start, long *end_index) {
+  char *end;
+  errno = 0;
+  long first = strtol(arg, &end, 10);
+  if (arg == end || errno == ERANGE || first < 0) {
+    return -1;
+  }
+
+  long last = first;
+  if (*end == ':') {
+    const char *last_arg = end + 1;
+    last = strtol(last_arg, &end, 10);
+    if (last_arg == end || errno == ERANGE) {
+      return -1;
+    }
+  } else {
+    first = 0;
+  }
+
+  if (*end || last < first || last > LONG_MAX - 2) {
+    return -1;
+  }
+  *start = first;
+  *end_index = last;
+  return 0;
+}
+
+/**
+ * Prints a closed-form aggregate over F(a..b), optionally reduced modulo a value.
+ *
+ * @return EXIT_SUCCESS or EXIT_FAILURE
+ */
+static int run_aggregate(AggregateKind kind, long a, long b, const char *modulus_spec,
+                         OutputFormat format, int raw_output, int show_time, FILE *output,
+                         int verbose) {
+  mpz_t result, modulus;
+  mpz_init(result);
+  mpz_init(modulus);
+
+  if (modulus_spec != NULL &&
+      (read_big_integer(modulus, modulus_spec) != 0 || mpz_sgn(modulus) == 0)) {
+    fprintf(stderr, "Error: Modulus '%s' must be a positive integer\n", modulus_spec);
+    mpz_clear(result);
+    mpz_clear(modulus);
+    return EXIT_FAILURE;
+  }
+
+  const double start_time = monotonic_seconds();
+  if (fibonacci_aggregate(result, kind, a, b, modulus_spec != NULL ? modulus : NULL, verbose) !=
+      0) {
+    fprintf(stderr, "Error: Cannot compute the aggregate over F(%ld..%ld)\n", a, b);
+    mpz_clear(result);
+    mpz_clear(modulus);
+    return EXIT_FAILURE;
+  }
+  const double end_time = monotonic_seconds();
+  if (CALCULATION_CANCELLED()) {
+    mpz_clear(result);
+    mpz_clear(modulus);
+    return EXIT_TIMEOUT;
+  }
+
+  // Alternating sums can be negative; keep the sign ahead of the format prefix
+  const char *sign = mpz_sgn(result) < 0 ? "-" : "";
+  mpz_abs(result, result);
+  char *value = get_formatted_result(result, format, verbose);
+  if (value == NULL) {
+    mpz_clear(result);
+    mpz_clear(modulus);
+    return EXIT_FAILURE;
+  }
+
+  static const char *const labels[] = {"Sum", "Sum of squares", "Alternating sum"};
+  int written;
+  if (raw_output) {
+    written = fprintf(output, "%s%s%s\n", sign, get_format_prefix(format), value);
+  } else if (modulus_spec != NULL) {
+    written = gmp_fprintf(output, "%s of F(%ld..%ld) mod %Zd: %s%s%s\n", labels[kind], a, b,
+                          modulus, sign, get_format_prefix(format), value);
+  } else {
+    written = fprintf(output, "%s of F(%ld..%ld): %s%s%s\n", labels[kind], a, b, sign,
+                      get_format_prefix(format), value);
+  }
+
+  if (written >= 0 && show_time) {
+    const double time_taken = end_time - start_time;
+    written = fprintf(output, "Calculation Time: %lf seconds\n", time_taken);
+  }
+
+  free(value);
+  mpz_clear(result);
+  mpz_clear(modulus);
+  return written < 0 ? EXIT_FAILURE : EXIT_SUCCESS;
+}
+
+/**
+ * Searches F(a..b) for probable primes on a pool of worker threads.
+ *
+ * @return EXIT_SUCCESS or EXIT_FAILURE
+ */
+static int run_prime_search(long a, long b, int threads, const char *state_path, int raw_output,
+                            int show_time, FILE *output, int verbose) {
+  if (threads <= 0) {
+    long online = sysconf(_SC_NPROCESSORS_ONLN);
+    threads = online > 0 ? (int) online : 1;
+  }
+
+  const double start_time = monotonic_seconds();
+  if (fibonacci_prime_search(a, b, threads, state_path, output, raw_output, verbose) != 0) {
+    fprintf(stderr, "Error: Prime search over F(%ld..%ld) failed\n", a, b);
+    return EXIT_FAILURE;
+  }
+  const double end_time = monotonic_seconds();
+  if (CALCULATION_CANCELLED()) {
+    return EXIT_TIMEOUT;
+  }
+
+  if (show_time) {
+    const double time_taken = end_time - start_time;
+    if (fprintf(output, "Calculation Time: %lf seconds\n", time_taken) < 0) {
+      return EXIT_FAILURE;
+    }
+  }
+  return EXIT_SUCCESS;
+}
+
+/**
+ * Computes term n of the recurrence given by spec into result.
+ *
+ * @return EXIT_SUCCESS or EXIT_FAILURE
+ */
+static int run_recurrence(mpz_t result, const char *spec, long n, int verbose) {
+  Recurrence rec;
+  if (recurrence_parse(&rec, spec) != 0) {
+    fprintf(stderr, "Error: Invalid recurrence '%s'\n", spec);
+    return EXIT_FAILURE;
+  }
+
+  int status = calculate_recurrence(result, &rec, n, verbose);
+  recurrence_clear(&rec);
+  if (status != 0) {
+    fprintf(stderr, "Error: Cannot compute term %ld of recurrence '%s'\n", n, spec);
+    return EXIT_FAILURE;
+  }
+  return EXIT_SUCCESS;
+}
+
+/**
+ * Writes Zeckendorf digits as packed bytes: bit j (LSB first) is the coefficient of F(j + 2).
+ */
+static int write_packed_digits(FILE *output, const unsigned char *digits, size_t count) {
+  unsigned char buffer[4096];
+  size_t used = 0;
+
+  for (size_t i = 0; i < count; i += 8) {
+    unsigned char byte = 0;
+    for (size_t bit = 0; bit < 8 && i + bit < count; bit++) {
+      byte |= (unsigned char) (digits[i + bit] << bit);
+    }
+    buffer[used++] = byte;
+    if (used == sizeof(buffer)) {
+      if (fwrite(buffer, 1, used, output) != used) {
+        return -1;
+      }
+      used = 0;
+    }
+  }
+
+  if (used > 0 && fwrite(buffer, 1, used, output) != used) {
+    return -1;
+  }
+  return 0;
+}
+
+/**
+ * Reads a value and prints its Zeckendorf representation, most significant digit first.
+ *
+ * @return EXIT_SUCCESS or EXIT_FAILURE
+ */
+static int run_zeckendorf(const char *spec, int packed, int raw_output, int show_time,
+                          FILE *output, int verbose) {
+  mpz_t value;
+  mpz_init(value);
+
+  if (read_big_integer(value, spec) != 0) {
+    fprintf(stderr, "Error: Cannot parse '%s' as a non-negative integer\n", spec);
+    mpz_clear(value);
+    return EXIT_FAILURE;
+  }
+
+  size_t count = 0;
+  const double start_time = monotonic_seconds();
+  unsigned char *digits = zeckendorf_representation(value, &count, verbose);
+  const double end_time = monotonic_seconds();
+  mpz_clear(value);
+  if (CALCULATION_CANCELLED()) {
+    free(digits);
+    return EXIT_TIMEOUT;
+  }
+
+  if (digits == NULL) {
+    fprintf(stderr, "Error: Cannot decompose '%s'\n", spec);
+    return EXIT_FAILURE;
+  }
+
+  int status = 0;
+  if (packed) {
+    status = write_packed_digits(output, digits, count);
+  } else {
+    // Render into the digit buffer itself, most significant first
+    char *text = malloc(count + 2);
+    if (text == NULL) {
+      free(digits);
+      return EXIT_FAILURE;
+    }
+    for (size_t i = 0; i < count; i++) {
+      text[i] = (char) ('0' + digits[count - 1 - i]);
+    }
+    if (count == 0) {
+      text[count++] = '0';
+    }
+    text[count] = '\0';
+
+    if (raw_output) {
+      status = fprintf(output, "%s\n", text) < 0 ? -1 : 0;
+    } else {
+      status = fprintf(output, "Zeckendorf Representation: %s\n", text) < 0 ? -1 : 0;
+    }
+    free(text);
+  }
+  free(digits);
+
+  if (status == 0 && show_time && !packed) {
+    const double time_taken = end_time - start_time;
+    status = fprintf(output, "Calculation Time: %lf seconds\n", time_taken) < 0 ? -1 : 0;
+  }
+
+  return status < 0 ? EXIT_FAILURE : EXIT_SUCCESS;
+}
+
+/**
+ * Reports a run stopped by --timeout: how far the task got and the time spent in each phase.
+ */
+static void report_timeout(PhaseTimer *timer, double timeout) {
+  phase_timer_end(timer);
+  fprintf(stderr, "Error: Timed out after %g seconds\n", timeout);
+  progress_report(stderr);
+  phase_timer_report_text(timer, stderr);
+}
+
 /**
  * Main entry point for the Fibonacci calculator program.
  *
@@ -283,6 +823,10 @@ static void cleanup_resources(char *output_file, int free_args, int argc, char *
  *
  * Command-line usage:
  *   fib <n> [options]
+ *   fib --index-of <value> [options]
+ *   fib --zeckendorf <value> [--packed] [options]
+ *   fib --sum|--sum-squares|--alt-sum <[a:]b> [--mod <m>] [options]
+ *   fib --prime-search <[a:]b> [--threads <count>] [--search-state <file>] [options]
  *
  * Options:
  *   -h, --help              Display help information
@@ -293,6 +837,37 @@ static void cleanup_resources(char *output_file, int free_args, int argc, char *
  *   -f, --format <fmt>      Output format: dec, hex, or bin (default: dec)
  *   -a, --algorithm <algo>  Algorithm: iter, recur, or matrix (default: matrix)
  *   -o, --output <file>     Write output to file instead of stdout
+ *   --leading <k>           Print only the first k digits of the result
+ *   --digits, --bits        Print only the number of digits (or bits) of the result
+ *   --digits-at <pos:len>   Print len digits starting pos digits above the least significant
+ *   --index-of <value>      Print the index of a Fibonacci number (no <n> argument)
+ *   --zeckendorf <value>    Print the Zeckendorf representation of a value (no <n> argument)
+ *   --packed                Write the Zeckendorf digits as a packed LSB-first bitstream
+ *   --sum <[a:]b>           Print the sum of F(a..b) (no <n> argument)
+ *   --sum-squares <[a:]b>   Print the sum of F(i)^2 over a..b (no <n> argument)
+ *   --alt-sum <[a:]b>       Print the alternating sum of (-1)^i F(i) over a..b (no <n> argument)
+ *   --mod <m>               Reduce an aggregate modulo m
+ *   --recurrence <spec>     Compute term n of "c1,...,ck;s0,...,sk-1" or a preset such as lucas
+ *   --verify                Check the result modulo random primes
+ *   --digest <algo>         Print a sha256 or xxh64 digest of the result digits
+ *   --digit-stats           Print how often each digit occurs in the result
+ *   --prime-search <[a:]b>  List indices n in a..b with F(n) a probable prime (no <n> argument)
+ *   --threads <count>       Worker threads for --prime-search (default: online CPUs)
+ *   --search-state <file>   Record --prime-search progress in file and resume from it
+ *   --cache                 Reuse cached pairs and renderings from ~/.fib_cache
+ *   --cache-size <MiB>      Size budget of the cache (implies --cache)
+ *   --checkpoint <file>     Periodically save the doubling ladder state to file
+ *   --checkpoint-interval <secs>  Seconds between checkpoints (default: 60)
+ *   --resume <file>         Continue from a checkpoint written by --checkpoint
+ *   --out-of-core <dir>     Keep large operands in file-backed mappings under dir
+ *   --max-resident <MiB>    Resident budget for the out-of-core mappings (default: 1024)
+ *   --max-memory <MiB>      Refuse runs predicted to exceed this peak, or use low-memory mode
+ *   --allocator <name>      GMP allocator: system or arena (default: $FIB_ALLOCATOR or system)
+ *   --alloc-stats[=json]    Report GMP allocation statistics on stderr at exit
+ *   --timing=json           Report wall and CPU time of each phase on stderr as JSON
+ *   --perf-counters         Count cycles, instructions and cache, TLB and branch misses per phase
+ *   --trace <file>          Write Chrome trace events of the computation to file
+ *   --timeout <secs>        Give up after secs, exiting with status 124 and a progress report
  *
  * If no arguments are provided, launches an interactive user interface.
  */
@@ -300,18 +875,68 @@ int main(int argc, char *argv[]) {
   // Track whether we need to free dynamically generated arguments
   int free_args = 0;
 
+  // SIGUSR1 asks for a progress dump at any point of the run, so it must never fall back to
+  // its default action of terminating the process
+  progress_install_handler();
+
   // Step 1: Launch interactive UI if no command-line arguments provided
   if (argc < 2) {
     run_user_interface(&argc, &argv);
     free_args = 1;
   }
 
+  // Everything up to the computation counts as argument parsing
+  PhaseTimer timer;
+  phase_timer_init(&timer);
+  phase_timer_begin(&timer, PHASE_PARSE);
+  const double run_start = timer.wall_start;  // --timeout counts from here
+
   // Step 2: Initialize configuration variables with defaults
   int show_time = 0;
   int time_only = 0;
   int raw_output = 0;
   int verbose = 0;
   long limit = -1;
+  unsigned long leading_digits = 0;
+  int count_digits = 0;
+  int count_bits = 0;
+  unsigned long window_pos = 0;
+  unsigned long window_len = 0;
+  const char *index_of = NULL;
+  const char *zeckendorf = NULL;
+  int packed = 0;
+  const char *aggregate_option = NULL;
+  AggregateKind aggregate_kind = AGGREGATE_SUM;
+  long range_start = 0;
+  long range_end = 0;
+  const char *modulus_spec = NULL;
+  const char *recurrence_spec = NULL;
+  int verify = 0;
+  DigestKind digest = DIGEST_NONE;
+  int digit_stats = 0;
+  int prime_search = 0;
+  long search_start = 0;
+  long search_end = 0;
+  long search_threads = 0;
+  const char *search_state = NULL;
+  int use_cache = 0;
+  unsigned long long cache_budget = (unsigned long long) DEFAULT_CACHE_MIB << 20;
+  const char *checkpoint_path = NULL;
+  double checkpoint_interval = -1.0;
+  double timeout = 0.0;
+  const char *resume_path = NULL;
+  const char *out_of_core_dir = NULL;
+  unsigned long long resident_budget = 0;
+  unsigned long long memory_budget = 0;
+  int low_memory = 0;
+  size_t predicted_peak = 0;
+  const char *allocator = NULL;
+  int alloc_stats = 0;
+  int alloc_stats_json = 0;
+  int timing_json = 0;
+  int perf_counters = 0;
+  const char *trace_path = NULL;
+  const char *sequence_label = "Fibonacci Number";
   char *output_file = NULL;
   Algorithm algo = MATRIX;
   OutputFormat format = DECIMAL;
@@ -417,33 +1042,388 @@ int main(int argc, char *argv[]) {
         return EXIT_FAILURE;
       }
     }
-    // Handle the Fibonacci number argument (non-option argument)
-    else if (limit == -1) {
-      // Check for unknown options (arguments starting with -)
-      if (argv[i][0] == '-' && argv[i][1] != '\0') {
-        fprintf(stderr, "Unknown option: %s\n", argv[i]);
-        fprintf(stderr, "Try '%s --help' for more information.\n", argv[0]);
+    // Handle leading digits option
+    else if (strcmp(argv[i], "--leading") == 0) {
+      if (i + 1 < argc) {
+        char *end;
+        errno = 0;
+        leading_digits = strtoul(argv[i + 1], &end, 10);
+        if (argv[i + 1] == end || *end || argv[i + 1][0] == '-' || errno == ERANGE ||
+            leading_digits == 0) {
+          fprintf(stderr, "Error: Invalid digit count '%s' for --leading option\n", argv[i + 1]);
+          cleanup_resources(output_file, free_args, argc, argv);
+          return EXIT_FAILURE;
+        }
+        i += 2;
+      } else {
+        fprintf(stderr, "Error: Missing digit count for --leading option\n");
         cleanup_resources(output_file, free_args, argc, argv);
         return EXIT_FAILURE;
       }
-
-      // Parse the Fibonacci number from the argument
-      char *end;
-      errno = 0;
-      limit = strtol(argv[i], &end, 10);
-      if ((argv[i] == end) || *end) {
-        fprintf(stderr, "Error Parsing %s\n", argv[i]);
+    }
+    // Handle digit window option
+    else if (strcmp(argv[i], "--digits-at") == 0) {
+      if (i + 1 < argc) {
+        char *end;
+        errno = 0;
+        window_pos = strtoul(argv[i + 1], &end, 10);
+        if (argv[i + 1] == end || *end != ':' || argv[i + 1][0] == '-' || errno == ERANGE) {
+          fprintf(stderr, "Error: Invalid window '%s' for --digits-at option\n", argv[i + 1]);
+          fprintf(stderr, "Expected POS:LEN, e.g. --digits-at 1000:50\n");
+          cleanup_resources(output_file, free_args, argc, argv);
+          return EXIT_FAILURE;
+        }
+        const char *len_arg = end + 1;
+        window_len = strtoul(len_arg, &end, 10);
+        if (len_arg == end || *end || len_arg[0] == '-' || errno == ERANGE || window_len == 0) {
+          fprintf(stderr, "Error: Invalid window '%s' for --digits-at option\n", argv[i + 1]);
+          fprintf(stderr, "Expected POS:LEN, e.g. --digits-at 1000:50\n");
+          cleanup_resources(output_file, free_args, argc, argv);
+          return EXIT_FAILURE;
+        }
+        i += 2;
+      } else {
+        fprintf(stderr, "Error: Missing window for --digits-at option\n");
         cleanup_resources(output_file, free_args, argc, argv);
         return EXIT_FAILURE;
-      } else if (errno == ERANGE) {
-        perror(argv[i]);
+      }
+    }
+    // Handle inverse lookup option
+    else if (strcmp(argv[i], "--index-of") == 0) {
+      if (i + 1 < argc) {
+        index_of = argv[i + 1];
+        i += 2;
+      } else {
+        fprintf(stderr, "Error: Missing value for --index-of option\n");
         cleanup_resources(output_file, free_args, argc, argv);
         return EXIT_FAILURE;
       }
-      i++;
     }
-    // Handle unexpected extra arguments
-    else {
+    // Handle Zeckendorf decomposition options
+    else if (strcmp(argv[i], "--zeckendorf") == 0) {
+      if (i + 1 < argc) {
+        zeckendorf = argv[i + 1];
+        i += 2;
+      } else {
+        fprintf(stderr, "Error: Missing value for --zeckendorf option\n");
+        cleanup_resources(output_file, free_args, argc, argv);
+        return EXIT_FAILURE;
+      }
+    } else if (strcmp(argv[i], "--packed") == 0) {
+      packed = 1;
+      i++;
+    }
+    // Handle closed-form aggregate options
+    else if (strcmp(argv[i], "--sum") == 0 || strcmp(argv[i], "--sum-squares") == 0 ||
+             strcmp(argv[i], "--alt-sum") == 0) {
+      if (aggregate_option != NULL) {
+        fprintf(stderr, "Error: Only one of --sum, --sum-squares and --alt-sum may be used\n");
+        cleanup_resources(output_file, free_args, argc, argv);
+        return EXIT_FAILURE;
+      }
+      aggregate_option = argv[i];
+      if (strcmp(argv[i], "--sum-squares") == 0) {
+        aggregate_kind = AGGREGATE_SUM_SQUARES;
+      } else if (strcmp(argv[i], "--alt-sum") == 0) {
+        aggregate_kind = AGGREGATE_ALTERNATING;
+      }
+      if (i + 1 < argc) {
+        if (parse_index_range(argv[i + 1], &range_start, &range_end) != 0) {
+          fprintf(stderr, "Error: Invalid range '%s' for %s option\n", argv[i + 1], argv[i]);
+          fprintf(stderr, "Expected B or A:B with 0 <= A <= B, e.g. %s 10:100\n", argv[i]);
+          cleanup_resources(output_file, free_args, argc, argv);
+          return EXIT_FAILURE;
+        }
+        i += 2;
+      } else {
+        fprintf(stderr, "Error: Missing range for %s option\n", argv[i]);
+        cleanup_resources(output_file, free_args, argc, argv);
+        return EXIT_FAILURE;
+      }
+    } else if (strcmp(argv[i], "--mod") == 0) {
+      if (i + 1 < argc) {
+        modulus_spec = argv[i + 1];
+        i += 2;
+      } else {
+        fprintf(stderr, "Error: Missing modulus for --mod option\n");
+        cleanup_resources(output_file, free_args, argc, argv);
+        return EXIT_FAILURE;
+      }
+    }
+    // Handle generic recurrence option
+    else if (strcmp(argv[i], "--recurrence") == 0) {
+      if (i + 1 < argc) {
+        recurrence_spec = argv[i + 1];
+        i += 2;
+      } else {
+        fprintf(stderr, "Error: Missing specification for --recurrence option\n");
+        cleanup_resources(output_file, free_args, argc, argv);
+        return EXIT_FAILURE;
+      }
+    }
+    // Handle result verification option
+    else if (strcmp(argv[i], "--verify") == 0) {
+      verify = 1;
+      i++;
+    }
+    // Handle digest and digit statistics options
+    else if (strcmp(argv[i], "--digest") == 0) {
+      if (i + 1 < argc) {
+        if (strcmp(argv[i + 1], "sha256") == 0) {
+          digest = DIGEST_SHA256;
+        } else if (strcmp(argv[i + 1], "xxh64") == 0) {
+          digest = DIGEST_XXH64;
+        } else {
+          fprintf(stderr, "Error: Unknown digest '%s'\n", argv[i + 1]);
+          fprintf(stderr, "Valid options: sha256, xxh64\n");
+          cleanup_resources(output_file, free_args, argc, argv);
+          return EXIT_FAILURE;
+        }
+        i += 2;
+      } else {
+        fprintf(stderr, "Error: Missing algorithm for --digest option\n");
+        cleanup_resources(output_file, free_args, argc, argv);
+        return EXIT_FAILURE;
+      }
+    } else if (strcmp(argv[i], "--digit-stats") == 0) {
+      digit_stats = 1;
+      i++;
+    }
+    // Handle Fibonacci prime search options
+    else if (strcmp(argv[i], "--prime-search") == 0) {
+      if (i + 1 < argc) {
+        if (parse_index_range(argv[i + 1], &search_start, &search_end) != 0) {
+          fprintf(stderr, "Error: Invalid range '%s' for --prime-search option\n", argv[i + 1]);
+          fprintf(stderr, "Expected B or A:B with 0 <= A <= B, e.g. --prime-search 1000:5000\n");
+          cleanup_resources(output_file, free_args, argc, argv);
+          return EXIT_FAILURE;
+        }
+        prime_search = 1;
+        i += 2;
+      } else {
+        fprintf(stderr, "Error: Missing range for --prime-search option\n");
+        cleanup_resources(output_file, free_args, argc, argv);
+        return EXIT_FAILURE;
+      }
+    } else if (strcmp(argv[i], "--threads") == 0) {
+      if (i + 1 < argc) {
+        char *end;
+        errno = 0;
+        search_threads = strtol(argv[i + 1], &end, 10);
+        if (argv[i + 1] == end || *end || errno == ERANGE || search_threads < 1 ||
+            search_threads > 1024) {
+          fprintf(stderr, "Error: Invalid thread count '%s' for --threads option\n", argv[i + 1]);
+          cleanup_resources(output_file, free_args, argc, argv);
+          return EXIT_FAILURE;
+        }
+        i += 2;
+      } else {
+        fprintf(stderr, "Error: Missing count for --threads option\n");
+        cleanup_resources(output_file, free_args, argc, argv);
+        return EXIT_FAILURE;
+      }
+    } else if (strcmp(argv[i], "--search-state") == 0) {
+      if (i + 1 < argc) {
+        search_state = argv[i + 1];
+        i += 2;
+      } else {
+        fprintf(stderr, "Error: Missing filename for --search-state option\n");
+        cleanup_resources(output_file, free_args, argc, argv);
+        return EXIT_FAILURE;
+      }
+    }
+    // Handle the pair cache options
+    else if (strcmp(argv[i], "--cache") == 0) {
+      use_cache = 1;
+      i++;
+    } else if (strcmp(argv[i], "--cache-size") == 0) {
+      if (i + 1 < argc) {
+        char *end;
+        errno = 0;
+        long mib = strtol(argv[i + 1], &end, 10);
+        if (argv[i + 1] == end || *end || errno == ERANGE || mib < 1 || mib > (1L << 30)) {
+          fprintf(stderr, "Error: Invalid size '%s' for --cache-size option\n", argv[i + 1]);
+          cleanup_resources(output_file, free_args, argc, argv);
+          return EXIT_FAILURE;
+        }
+        cache_budget = (unsigned long long) mib << 20;
+        use_cache = 1;
+        i += 2;
+      } else {
+        fprintf(stderr, "Error: Missing size for --cache-size option\n");
+        cleanup_resources(output_file, free_args, argc, argv);
+        return EXIT_FAILURE;
+      }
+    }
+    // Handle checkpoint and resume options
+    else if (strcmp(argv[i], "--checkpoint") == 0) {
+      if (i + 1 < argc) {
+        checkpoint_path = argv[i + 1];
+        i += 2;
+      } else {
+        fprintf(stderr, "Error: Missing filename for --checkpoint option\n");
+        cleanup_resources(output_file, free_args, argc, argv);
+        return EXIT_FAILURE;
+      }
+    } else if (strcmp(argv[i], "--checkpoint-interval") == 0) {
+      if (i + 1 < argc) {
+        char *end;
+        errno = 0;
+        checkpoint_interval = strtod(argv[i + 1], &end);
+        if (argv[i + 1] == end || *end || errno == ERANGE || !(checkpoint_interval >= 0.0)) {
+          fprintf(stderr, "Error: Invalid interval '%s' for --checkpoint-interval option\n",
+                  argv[i + 1]);
+          cleanup_resources(output_file, free_args, argc, argv);
+          return EXIT_FAILURE;
+        }
+        i += 2;
+      } else {
+        fprintf(stderr, "Error: Missing seconds for --checkpoint-interval option\n");
+        cleanup_resources(output_file, free_args, argc, argv);
+        return EXIT_FAILURE;
+      }
+    } else if (strcmp(argv[i], "--timeout") == 0) {
+      if (i + 1 < argc) {
+        char *end;
+        errno = 0;
+        timeout = strtod(argv[i + 1], &end);
+        if (argv[i + 1] == end || *end || errno == ERANGE || !(timeout > 0.0)) {
+          fprintf(stderr, "Error: Invalid seconds '%s' for --timeout option\n", argv[i + 1]);
+          cleanup_resources(output_file, free_args, argc, argv);
+          return EXIT_FAILURE;
+        }
+        i += 2;
+      } else {
+        fprintf(stderr, "Error: Missing seconds for --timeout option\n");
+        cleanup_resources(output_file, free_args, argc, argv);
+        return EXIT_FAILURE;
+      }
+    } else if (strcmp(argv[i], "--resume") == 0) {
+      if (i + 1 < argc) {
+        resume_path = argv[i + 1];
+        i += 2;
+      } else {
+        fprintf(stderr, "Error: Missing filename for --resume option\n");
+        cleanup_resources(output_file, free_args, argc, argv);
+        return EXIT_FAILURE;
+      }
+    }
+    // Handle out-of-core options
+    else if (strcmp(argv[i], "--out-of-core") == 0) {
+      if (i + 1 < argc) {
+        out_of_core_dir = argv[i + 1];
+        i += 2;
+      } else {
+        fprintf(stderr, "Error: Missing directory for --out-of-core option\n");
+        cleanup_resources(output_file, free_args, argc, argv);
+        return EXIT_FAILURE;
+      }
+    } else if (strcmp(argv[i], "--max-resident") == 0) {
+      if (i + 1 < argc) {
+        char *end;
+        errno = 0;
+        long mib = strtol(argv[i + 1], &end, 10);
+        if (argv[i + 1] == end || *end || errno == ERANGE || mib < 1 || mib > (1L << 30)) {
+          fprintf(stderr, "Error: Invalid size '%s' for --max-resident option\n", argv[i + 1]);
+          cleanup_resources(output_file, free_args, argc, argv);
+          return EXIT_FAILURE;
+        }
+        resident_budget = (unsigned long long) mib << 20;
+        i += 2;
+      } else {
+        fprintf(stderr, "Error: Missing size for --max-resident option\n");
+        cleanup_resources(output_file, free_args, argc, argv);
+        return EXIT_FAILURE;
+      }
+    }
+    // Handle memory budget option
+    else if (strcmp(argv[i], "--max-memory") == 0) {
+      if (i + 1 < argc) {
+        char *end;
+        errno = 0;
+        long mib = strtol(argv[i + 1], &end, 10);
+        if (argv[i + 1] == end || *end || errno == ERANGE || mib < 1 || mib > (1L << 30)) {
+          fprintf(stderr, "Error: Invalid size '%s' for --max-memory option\n", argv[i + 1]);
+          cleanup_resources(output_file, free_args, argc, argv);
+          return EXIT_FAILURE;
+        }
+        memory_budget = (unsigned long long) mib << 20;
+        i += 2;
+      } else {
+        fprintf(stderr, "Error: Missing size for --max-memory option\n");
+        cleanup_resources(output_file, free_args, argc, argv);
+        return EXIT_FAILURE;
+      }
+    }
+    // Handle allocator option
+    else if (strcmp(argv[i], "--allocator") == 0) {
+      if (i + 1 < argc) {
+        allocator = argv[i + 1];
+        i += 2;
+      } else {
+        fprintf(stderr, "Error: Missing name for --allocator option\n");
+        cleanup_resources(output_file, free_args, argc, argv);
+        return EXIT_FAILURE;
+      }
+    } else if (strcmp(argv[i], "--alloc-stats") == 0 ||
+               strcmp(argv[i], "--alloc-stats=text") == 0) {
+      alloc_stats = 1;
+      i++;
+    } else if (strcmp(argv[i], "--alloc-stats=json") == 0) {
+      alloc_stats = 1;
+      alloc_stats_json = 1;
+      i++;
+    } else if (strcmp(argv[i], "--timing=json") == 0) {
+      timing_json = 1;
+      i++;
+    } else if (strcmp(argv[i], "--perf-counters") == 0) {
+      perf_counters = 1;
+      i++;
+    } else if (strcmp(argv[i], "--trace") == 0) {
+      if (i + 1 < argc) {
+        trace_path = argv[i + 1];
+        i += 2;
+      } else {
+        fprintf(stderr, "Error: Missing filename for --trace option\n");
+        cleanup_resources(output_file, free_args, argc, argv);
+        return EXIT_FAILURE;
+      }
+    }
+    // Handle digit and bit count queries
+    else if (strcmp(argv[i], "--digits") == 0) {
+      count_digits = 1;
+      i++;
+    } else if (strcmp(argv[i], "--bits") == 0) {
+      count_bits = 1;
+      i++;
+    }
+    // Handle the Fibonacci number argument (non-option argument)
+    else if (limit == -1) {
+      // Check for unknown options (arguments starting with -)
+      if (argv[i][0] == '-' && argv[i][1] != '\0') {
+        fprintf(stderr, "Unknown option: %s\n", argv[i]);
+        fprintf(stderr, "Try '%s --help' for more information.\n", argv[0]);
+        cleanup_resources(output_file, free_args, argc, argv);
+        return EXIT_FAILURE;
+      }
+
+      // Parse the Fibonacci number from the argument
+      char *end;
+      errno = 0;
+      limit = strtol(argv[i], &end, 10);
+      if ((argv[i] == end) || *end) {
+        fprintf(stderr, "Error Parsing %s\n", argv[i]);
+        cleanup_resources(output_file, free_args, argc, argv);
+        return EXIT_FAILURE;
+      } else if (errno == ERANGE) {
+        perror(argv[i]);
+        cleanup_resources(output_file, free_args, argc, argv);
+        return EXIT_FAILURE;
+      }
+      i++;
+    }
+    // Handle unexpected extra arguments
+    else {
       fprintf(stderr,
               "Usage: %s <limit> [-h] [-t] [-T] [-r] [-v] [-f format] [-a algo] [-o filename]\n",
               argv[0]);
@@ -453,8 +1433,176 @@ int main(int argc, char *argv[]) {
     }
   }
 
-  // Step 4: Validate that the required Fibonacci number was provided
-  if (limit == -1) {
+  // From here on the reporter answers SIGUSR1, including requests made while parsing
+  progress_start_reporter(verbose, 0.0);
+
+  // Step 4: Validate the selected mode and that the required Fibonacci number was provided
+  int query_modes = (leading_digits > 0) + count_digits + count_bits + (window_len > 0) +
+                    (index_of != NULL) + (zeckendorf != NULL) + (aggregate_option != NULL) +
+                    prime_search;
+  if (query_modes > 1) {
+    fprintf(stderr,
+            "Error: Only one of --leading, --digits, --bits, --digits-at, --index-of, "
+            "--zeckendorf, --prime-search and the aggregate options may be used\n");
+    cleanup_resources(output_file, free_args, argc, argv);
+    return EXIT_FAILURE;
+  }
+  if ((search_threads > 0 || search_state != NULL) && !prime_search) {
+    fprintf(stderr, "Error: --threads and --search-state require --prime-search\n");
+    cleanup_resources(output_file, free_args, argc, argv);
+    return EXIT_FAILURE;
+  }
+  if (modulus_spec != NULL && aggregate_option == NULL) {
+    fprintf(stderr, "Error: --mod requires --sum, --sum-squares or --alt-sum\n");
+    cleanup_resources(output_file, free_args, argc, argv);
+    return EXIT_FAILURE;
+  }
+  if (packed && zeckendorf == NULL) {
+    fprintf(stderr, "Error: --packed requires --zeckendorf\n");
+    cleanup_resources(output_file, free_args, argc, argv);
+    return EXIT_FAILURE;
+  }
+
+  int checkpointed = checkpoint_path != NULL || resume_path != NULL;
+  if (checkpoint_interval >= 0.0 && checkpoint_path == NULL) {
+    fprintf(stderr, "Error: --checkpoint-interval requires --checkpoint\n");
+    cleanup_resources(output_file, free_args, argc, argv);
+    return EXIT_FAILURE;
+  }
+  if (checkpointed &&
+      (recurrence_spec != NULL || query_modes > 0 || use_cache || algo != MATRIX)) {
+    fprintf(stderr,
+            "Error: --checkpoint and --resume apply only to Fibonacci numbers computed with "
+            "the matrix algorithm, without --cache or query options\n");
+    cleanup_resources(output_file, free_args, argc, argv);
+    return EXIT_FAILURE;
+  }
+
+  if (resident_budget > 0 && out_of_core_dir == NULL) {
+    fprintf(stderr, "Error: --max-resident requires --out-of-core\n");
+    cleanup_resources(output_file, free_args, argc, argv);
+    return EXIT_FAILURE;
+  }
+  if (out_of_core_dir != NULL && (recurrence_spec != NULL || query_modes > 0 || use_cache)) {
+    fprintf(stderr,
+            "Error: --out-of-core applies only to full Fibonacci results, without --cache\n");
+    cleanup_resources(output_file, free_args, argc, argv);
+    return EXIT_FAILURE;
+  }
+
+  // FIB_ALLOCATOR only sets the default; out-of-core mode brings its own allocator
+  if (allocator == NULL && out_of_core_dir == NULL) {
+    allocator = getenv("FIB_ALLOCATOR");
+  }
+  int use_arena = allocator != NULL && strcmp(allocator, "arena") == 0;
+  if (allocator != NULL && !use_arena && strcmp(allocator, "system") != 0) {
+    fprintf(stderr, "Error: Unknown allocator '%s'\n", allocator);
+    fprintf(stderr, "Valid options: system, arena\n");
+    cleanup_resources(output_file, free_args, argc, argv);
+    return EXIT_FAILURE;
+  }
+  if (use_arena && out_of_core_dir != NULL) {
+    fprintf(stderr, "Error: --out-of-core uses its own allocator and cannot use the arena\n");
+    cleanup_resources(output_file, free_args, argc, argv);
+    return EXIT_FAILURE;
+  }
+
+  if ((alloc_stats || timing_json || perf_counters) && query_modes > 0) {
+    fprintf(stderr,
+            "Error: --alloc-stats, --timing and --perf-counters apply only to full results\n");
+    cleanup_resources(output_file, free_args, argc, argv);
+    return EXIT_FAILURE;
+  }
+
+  if (perf_counters && phase_timer_enable_counters(&timer) == 0) {
+    fprintf(stderr, "Warning: Hardware counters are not available here (see "
+                    "/proc/sys/kernel/perf_event_paranoid); continuing without them\n");
+    perf_counters = 0;
+  }
+
+  if (trace_path != NULL) {
+#ifdef FIB_NO_TRACE
+    fprintf(stderr, "Error: --trace is not available in this build (FIB_NO_TRACE)\n");
+    cleanup_resources(output_file, free_args, argc, argv);
+    return EXIT_FAILURE;
+#else
+    // The events are written when the program exits; the parse phase began before the
+    // trace was open, so its span is back-filled from the phase timer
+    if (trace_open(trace_path, run_start) != 0) {
+      fprintf(stderr, "Error: Cannot open trace file '%s'\n", trace_path);
+      cleanup_resources(output_file, free_args, argc, argv);
+      return EXIT_FAILURE;
+    }
+    timer.trace_start = trace_begin_at(timer.wall_start);
+#endif
+  }
+
+  if (memory_budget > 0 && (recurrence_spec != NULL || query_modes > 0 || use_cache ||
+                            checkpointed || out_of_core_dir != NULL)) {
+    fprintf(stderr,
+            "Error: --max-memory applies only to full Fibonacci results, without --cache, "
+            "--checkpoint or --out-of-core\n");
+    cleanup_resources(output_file, free_args, argc, argv);
+    return EXIT_FAILURE;
+  }
+
+  if (use_cache && (recurrence_spec != NULL || (query_modes > 0 && window_len == 0))) {
+    fprintf(stderr, "Error: --cache applies only to computed Fibonacci numbers\n");
+    cleanup_resources(output_file, free_args, argc, argv);
+    return EXIT_FAILURE;
+  }
+
+  if (verify && (recurrence_spec != NULL || (query_modes > 0 && window_len == 0))) {
+    fprintf(stderr, "Error: --verify applies only to computed Fibonacci numbers\n");
+    cleanup_resources(output_file, free_args, argc, argv);
+    return EXIT_FAILURE;
+  }
+
+  int digit_sinks = digest != DIGEST_NONE || digit_stats;
+  if (digit_sinks && query_modes > 0) {
+    fprintf(stderr, "Error: --digest and --digit-stats apply only to full results\n");
+    cleanup_resources(output_file, free_args, argc, argv);
+    return EXIT_FAILURE;
+  }
+
+  if (recurrence_spec != NULL) {
+    if (query_modes > 0) {
+      fprintf(stderr, "Error: --recurrence cannot be combined with query options\n");
+      cleanup_resources(output_file, free_args, argc, argv);
+      return EXIT_FAILURE;
+    }
+
+    Recurrence rec;
+    if (recurrence_parse(&rec, recurrence_spec) != 0) {
+      fprintf(stderr, "Error: Invalid recurrence '%s'\n", recurrence_spec);
+      fprintf(stderr,
+              "Expected C1,...,CK;S0,...,SK-1 with K coefficients and K seeds, or a preset: "
+              "lucas, pell, pell-lucas, jacobsthal, padovan, tribonacci, tetranacci\n");
+      cleanup_resources(output_file, free_args, argc, argv);
+      return EXIT_FAILURE;
+    }
+    sequence_label = rec.label;
+    recurrence_clear(&rec);
+  }
+
+  // Modes that take their operands from their own option instead of <n>
+  const char *standalone_option = aggregate_option;
+  if (index_of != NULL) {
+    standalone_option = "--index-of";
+  } else if (zeckendorf != NULL) {
+    standalone_option = "--zeckendorf";
+  } else if (prime_search) {
+    standalone_option = "--prime-search";
+  }
+
+  if (standalone_option != NULL) {
+    if (limit != -1) {
+      fprintf(stderr, "Error: %s does not take a Fibonacci number argument\n",
+              standalone_option);
+      cleanup_resources(output_file, free_args, argc, argv);
+      return EXIT_FAILURE;
+    }
+  } else if (limit == -1) {
     fprintf(stderr, "Error: Missing limit value\n");
     fprintf(stderr, "Try '%s --help' for more information.\n", argv[0]);
     cleanup_resources(output_file, free_args, argc, argv);
@@ -463,7 +1611,19 @@ int main(int argc, char *argv[]) {
 
   // Step 5: Display verbose information about the configuration
   if (verbose) {
-    fprintf(stderr, "Initializing Fibonacci calculation for n=%ld\n", limit);
+    if (index_of != NULL) {
+      fprintf(stderr, "Initializing Fibonacci index lookup\n");
+    } else if (zeckendorf != NULL) {
+      fprintf(stderr, "Initializing Zeckendorf decomposition\n");
+    } else if (aggregate_option != NULL) {
+      fprintf(stderr, "Initializing %s over F(%ld..%ld)\n", aggregate_option, range_start,
+              range_end);
+    } else if (prime_search) {
+      fprintf(stderr, "Initializing Fibonacci prime search over F(%ld..%ld)\n", search_start,
+              search_end);
+    } else {
+      fprintf(stderr, "Initializing Fibonacci calculation for n=%ld\n", limit);
+    }
     if (raw_output) {
       fprintf(stderr, "Raw output mode enabled\n");
     }
@@ -472,16 +1632,20 @@ int main(int argc, char *argv[]) {
     }
 
     // Display selected algorithm
-    switch (algo) {
-      case ITERATIVE:
-        fprintf(stderr, "Using iterative algorithm\n");
-        break;
-      case RECURSIVE:
-        fprintf(stderr, "Using recursive algorithm with memoization\n");
-        break;
-      case MATRIX:
-        fprintf(stderr, "Using matrix exponentiation algorithm\n");
-        break;
+    if (recurrence_spec != NULL) {
+      fprintf(stderr, "Using generic recurrence engine for %s\n", recurrence_spec);
+    } else {
+      switch (algo) {
+        case ITERATIVE:
+          fprintf(stderr, "Using iterative algorithm\n");
+          break;
+        case RECURSIVE:
+          fprintf(stderr, "Using recursive algorithm with memoization\n");
+          break;
+        case MATRIX:
+          fprintf(stderr, "Using matrix exponentiation algorithm\n");
+          break;
+      }
     }
 
     // Display selected output format
@@ -498,147 +1662,294 @@ int main(int argc, char *argv[]) {
     }
   }
 
-  // Step 6: Initialize the GMP big integer for storing the result
-  mpz_t result;
-  mpz_init(result);
+  // The deadline counts from the start of the run and covers the query modes too; the
+  // reporter raises calculation_cancelled when it passes
+  const double deadline = timeout > 0.0 ? run_start + timeout : 0.0;
+  progress_set_deadline(deadline);
 
-  // Step 7: Start timing if requested
-  clock_t start_time = (clock_t) 0;
-  if (show_time) {
-    start_time = clock();
-    if (start_time == (clock_t) -1) {
-      fprintf(stderr, "Error start_time clock()\n");
-      mpz_clear(result);
+  // Step 6: Answer queries that do not need the full Fibonacci number
+  if (query_modes > 0 && window_len == 0) {
+    if (standalone_option == NULL && limit < 0) {
+      fprintf(stderr, "Error: Fibonacci index must be non-negative\n");
       cleanup_resources(output_file, free_args, argc, argv);
       return EXIT_FAILURE;
     }
-    if (verbose) {
-      fprintf(stderr, "Started timing calculation\n");
+
+    FILE *output = open_output_stream(output_file, verbose);
+    if (output == NULL) {
+      cleanup_resources(output_file, free_args, argc, argv);
+      return EXIT_FAILURE;
     }
+
+    phase_timer_begin(&timer, PHASE_COMPUTE);
+    int status;
+    if (index_of != NULL) {
+      status = run_index_of(index_of, raw_output, show_time, output, verbose);
+    } else if (zeckendorf != NULL) {
+      status = run_zeckendorf(zeckendorf, packed, raw_output, show_time, output, verbose);
+    } else if (prime_search) {
+      status = run_prime_search(search_start, search_end, (int) search_threads, search_state,
+                                raw_output, show_time, output, verbose);
+    } else if (aggregate_option != NULL) {
+      status = run_aggregate(aggregate_kind, range_start, range_end, modulus_spec, format,
+                             raw_output, show_time, output, verbose);
+    } else if (leading_digits > 0) {
+      status = run_leading_digits(limit, leading_digits, format, raw_output, show_time, output,
+                                  verbose);
+    } else {
+      status = run_digit_count(limit, count_bits ? BINARY : format, raw_output, show_time, output,
+                               verbose);
+    }
+    if (status == EXIT_TIMEOUT) {
+      report_timeout(&timer, timeout);
+    }
+    if (close_output_stream(output, verbose) != 0 && status == EXIT_SUCCESS) {
+      status = EXIT_FAILURE;
+    }
+    cleanup_resources(output_file, free_args, argc, argv);
+    return status;
   }
 
-  // Step 8: Execute the selected Fibonacci calculation algorithm
-  if (verbose) {
-    fprintf(stderr, "Calculating Fibonacci number...\n");
+  // A cached rendering of the same result answers without computing or converting F(n)
+  CacheLock *render_lock = NULL;
+  int render_cache = use_cache && recurrence_spec == NULL && query_modes == 0 && !time_only &&
+                     !digit_sinks && !verify && !alloc_stats && !timing_json &&
+                     !perf_counters;
+  if (render_cache) {
+    if (limit < 0) {
+      fprintf(stderr, "Error: Fibonacci index must be non-negative\n");
+      cleanup_resources(output_file, free_args, argc, argv);
+      return EXIT_FAILURE;
+    }
+    int status =
+        run_cached_rendering(limit, algo, format, raw_output, show_time, output_file, verbose);
+    if (status == -1) {
+      // Identical invocations wait for the first one and then serve what it published
+      render_lock = render_cache_lock(limit, format, raw_output, verbose);
+      status =
+          run_cached_rendering(limit, algo, format, raw_output, show_time, output_file, verbose);
+    }
+    if (status != -1) {
+      cache_lock_release(render_lock);
+      cleanup_resources(output_file, free_args, argc, argv);
+      return status;
+    }
   }
 
-  switch (algo) {
-    case ITERATIVE:
-      calculate_fibonacci_iterative(result, limit, verbose);
-      break;
-    case RECURSIVE:
-      // Optimized recursive algorithm now uses O(1) memory
-      calculate_fibonacci_recursive(result, limit, NULL, verbose);
-      break;
-    case MATRIX:
-      calculate_fibonacci_matrix(result, limit, verbose);
-      break;
+  // Step 7: Initialize the GMP big integer for storing the result
+  // Out-of-core mode must be in place before GMP allocates anything that is still live
+  if (out_of_core_dir != NULL &&
+      memory_use_files(out_of_core_dir,
+                       resident_budget > 0 ? resident_budget
+                                           : (unsigned long long) DEFAULT_RESIDENT_MIB << 20,
+                       verbose) != 0) {
+    fprintf(stderr, "Error: Cannot use '%s' for out-of-core segments\n", out_of_core_dir);
+    cleanup_resources(output_file, free_args, argc, argv);
+    return EXIT_FAILURE;
+  }
+  if (use_arena) {
+    memory_use_arena(verbose);
   }
+  if (alloc_stats) {
+    memory_track_allocations();
+  }
+  // Under a memory budget, fall back to in-place doubling and streamed digits when the
+  // selected engine would not fit, and refuse the run when even that would not
+  if (memory_budget > 0) {
+    int write_digits = !time_only || digit_sinks;
+    predicted_peak = memory_predict_peak(limit, algo, format, write_digits, 0);
+    if (predicted_peak > memory_budget) {
+      predicted_peak = memory_predict_peak(limit, algo, format, write_digits, 1);
+      if (predicted_peak > memory_budget) {
+        fprintf(stderr,
+                "Error: F(%ld) needs about %.1f MiB even in low-memory mode, over the "
+                "--max-memory budget of %llu MiB\n",
+                limit, (double) predicted_peak / (1 << 20), memory_budget >> 20);
+        cleanup_resources(output_file, free_args, argc, argv);
+        return EXIT_FAILURE;
+      }
+      low_memory = 1;
+    }
+    if (verbose) {
+      fprintf(stderr, "Predicted peak memory %.1f MiB within a budget of %llu MiB%s\n",
+              (double) predicted_peak / (1 << 20), memory_budget >> 20,
+              low_memory ? "; using low-memory mode" : "");
+    }
+  }
+  mpz_t result;
+  mpz_init(result);
 
-  if (verbose) {
-    fprintf(stderr, "Calculation complete\n");
+  // Step 8: Start timing; wall-clock time also goes into the history entry
+  phase_timer_begin(&timer, PHASE_COMPUTE);
+  if (show_time && verbose) {
+    fprintf(stderr, "Started timing calculation\n");
   }
 
-  // Step 9: Stop timing if requested
-  clock_t end_time = (clock_t) 0;
-  if (show_time) {
-    end_time = clock();
-    if (end_time == (clock_t) -1) {
-      fprintf(stderr, "Error end_time clock()\n");
+  // Step 9: Execute the selected Fibonacci calculation algorithm; the engines publish their
+  // progress for -v updates and for SIGUSR1
+  if (verbose) {
+    fprintf(stderr, "Calculating Fibonacci number...\n");
+  }
+  if (recurrence_spec != NULL) {
+    if (run_recurrence(result, recurrence_spec, limit, verbose) != EXIT_SUCCESS) {
       mpz_clear(result);
       cleanup_resources(output_file, free_args, argc, argv);
       return EXIT_FAILURE;
     }
-    if (verbose) {
-      fprintf(stderr, "Finished timing calculation\n");
-    }
-  }
-
-  // Step 10: Open the output destination (file or stdout)
-  FILE *output = stdout;
-  if (output_file != NULL) {
-    if (verbose) {
-      fprintf(stderr, "Opening output file: %s\n", output_file);
-    }
-
-    // SECURITY: output_file has been fully sanitized by validate_output_path()
-    // The function breaks the taint chain by:
-    // 1. Sanitizing the filename to contain only safe characters (alphanumeric, -, _, .)
-    // 2. Resolving directory to canonical path via realpath()
-    // 3. Verifying the directory is in a safe location whitelist
-    // 4. Constructing a new path string from validated components
-    // This eliminates path traversal (CWE-22) and tainted path (CWE-73) vulnerabilities
-
-    // Use open() with O_CREAT | O_NOFOLLOW to safely create the file
-    // O_NOFOLLOW prevents following symlinks, mitigating TOCTOU attacks
-    int fd = open(output_file, O_WRONLY | O_CREAT | O_TRUNC | O_NOFOLLOW, 0644);
-    if (fd == -1) {
-      perror("Error opening output file");
+  } else if (use_cache) {
+    calculate_fibonacci_cached(result, limit, algo, cache_budget, verbose);
+  } else if (checkpointed) {
+    if (calculate_fibonacci_checkpointed(result, limit, checkpoint_path,
+                                         checkpoint_interval >= 0.0 ? checkpoint_interval
+                                                                    : DEFAULT_CHECKPOINT_INTERVAL,
+                                         resume_path, verbose) != 0) {
       mpz_clear(result);
       cleanup_resources(output_file, free_args, argc, argv);
       return EXIT_FAILURE;
     }
+  } else if (low_memory) {
+    calculate_fibonacci_low_memory(result, limit, verbose);
+  } else {
+    switch (algo) {
+      case ITERATIVE:
+        calculate_fibonacci_iterative(result, limit, verbose);
+        break;
+      case RECURSIVE:
+        // Optimized recursive algorithm now uses O(1) memory
+        calculate_fibonacci_recursive(result, limit, NULL, verbose);
+        break;
+      case MATRIX:
+        calculate_fibonacci_matrix(result, limit, verbose);
+        break;
+    }
+  }
 
-    // Convert file descriptor to FILE* stream
-    output = fdopen(fd, "w");
-    if (output == NULL) {
-      perror("Error creating file stream");
-      close(fd);
+  // Conversion cannot be interrupted, so a deadline that passed during the computation stops
+  // the run even when the engine got to the end
+  if (CALCULATION_CANCELLED() || (deadline > 0.0 && monotonic_seconds() >= deadline)) {
+    report_timeout(&timer, timeout);
+    mpz_clear(result);
+    cleanup_resources(output_file, free_args, argc, argv);
+    return EXIT_TIMEOUT;
+  }
+  // The reporter keeps answering SIGUSR1 until the output is written, without the deadline
+  progress_set_deadline(0.0);
+
+  if (verbose) {
+    fprintf(stderr, "Calculation complete\n");
+  }
+
+  // Step 10: Stop timing
+  phase_timer_end(&timer);
+  const double time_taken = timer.wall_seconds[PHASE_COMPUTE];
+  if (show_time && verbose) {
+    fprintf(stderr, "Finished timing calculation\n");
+  }
+
+  // Step 11: Check the result against modular fingerprints if requested
+  if (verify) {
+    phase_timer_begin(&timer, PHASE_VERIFY);
+    if (verbose) {
+      fprintf(stderr, "Verifying result against random prime fingerprints\n");
+    }
+    if (fibonacci_verify(result, limit, verbose) != 0) {
       mpz_clear(result);
       cleanup_resources(output_file, free_args, argc, argv);
       return EXIT_FAILURE;
     }
   }
 
+  // Step 12: Open the output destination (file or stdout)
+  phase_timer_begin(&timer, PHASE_OUTPUT);
+  FILE *output = open_output_stream(output_file, verbose);
+  if (output == NULL) {
+    mpz_clear(result);
+    cleanup_resources(output_file, free_args, argc, argv);
+    return EXIT_FAILURE;
+  }
+
   if (verbose) {
     fprintf(stderr, "Preparing to write result\n");
   }
 
-  // Step 11: Write the result to the output destination
+  // Step 13: Write the result to the output destination
   // Only write the result if time_only mode is not enabled
-  if (!time_only) {
-    // Write formatted label unless in raw output mode
-    if (!raw_output) {
-      const char *format_name;
-      switch (format) {
-        case DECIMAL:
-          format_name = "decimal";
-          break;
-        case HEXADECIMAL:
-          format_name = "hexadecimal";
-          break;
-        case BINARY:
-          format_name = "binary";
-          break;
-        default:
-          format_name = "decimal";
+  DigitSink *sink = NULL;
+  memory_set_phase(ALLOC_PHASE_CONVERSION);
+  phase_timer_begin(&timer, PHASE_CONVERSION);
+  if (!time_only && (out_of_core_dir != NULL || low_memory)) {
+    // Stream the digits from the limbs instead of building the whole string
+    char label[256];
+    format_result_label(label, sizeof(label), sequence_label, limit, format, raw_output, "");
+    sink = digit_sink_create(digest, digit_stats, format);
+    int status = sink != NULL && fputs(label, output) >= 0 ? 0 : -1;
+    if (status == 0) {
+      digit_sink_tee(sink, output);
+      status = digit_sink_stream(sink, result, verbose);
+      digit_sink_tee(sink, NULL);
+    }
+    memory_set_phase(ALLOC_PHASE_OUTPUT);
+    phase_timer_begin(&timer, PHASE_OUTPUT);
+    if (status != 0 || fputc('\n', output) == EOF) {
+      digit_sink_free(sink);
+      if (output != stdout) {
+        fclose(output);
       }
+      mpz_clear(result);
+      cleanup_resources(output_file, free_args, argc, argv);
+      return EXIT_FAILURE;
+    }
 
-      if (fprintf(output, "Fibonacci Number %ld (%s): %s", limit, format_name,
-                  format != DECIMAL ? get_format_prefix(format) : "") < 0) {
-        if (output != stdout) {
-          fclose(output);
-        }
-        mpz_clear(result);
-        cleanup_resources(output_file, free_args, argc, argv);
-        return EXIT_FAILURE;
-      }
+    phase_timer_begin(&timer, PHASE_HISTORY);
+    add_to_history(limit, algo, format, time_taken, digit_sink_head(sink));
+    phase_timer_begin(&timer, PHASE_OUTPUT);
+    if (!digit_sinks) {
+      digit_sink_free(sink);
+      sink = NULL;
     }
-    // In raw mode, only write the format prefix if not decimal
-    else if (format != DECIMAL) {
-      if (fprintf(output, "%s", get_format_prefix(format)) < 0) {
-        if (output != stdout) {
-          fclose(output);
-        }
-        mpz_clear(result);
-        cleanup_resources(output_file, free_args, argc, argv);
-        return EXIT_FAILURE;
+  } else if (!time_only) {
+    // Convert result (or only the requested digit window) to the requested format
+    char *result_str;
+    if (window_len > 0) {
+      result_str = fibonacci_digit_window(result, limit, window_pos, window_len, format, verbose);
+    } else {
+      result_str = get_formatted_result(result, format, verbose);
+    }
+    memory_set_phase(ALLOC_PHASE_OUTPUT);
+    phase_timer_begin(&timer, PHASE_OUTPUT);
+    if (result_str == NULL) {
+      if (output != stdout) {
+        fclose(output);
       }
+      mpz_clear(result);
+      cleanup_resources(output_file, free_args, argc, argv);
+      return EXIT_FAILURE;
     }
 
-    // Convert result to the requested format and write it
-    char *result_str = get_formatted_result(result, format, verbose);
-    if (result_str == NULL) {
+    // Recurrences with negative coefficients can go negative; the sign precedes the prefix
+    const char *sign = "";
+    const char *digits = result_str;
+    if (*digits == '-') {
+      sign = "-";
+      digits++;
+    }
+
+    // Write formatted label unless in raw output mode, where only the sign and the prefix
+    // of non-decimal formats precede the digits
+    char label[256];
+    int written = 0;
+    if (window_len > 0 && !raw_output) {
+      written = fprintf(output, "Fibonacci Number %ld (%s digits %lu-%lu): %s", limit,
+                        format_display_name(format), window_pos,
+                        window_pos + strlen(result_str) - 1,
+                        format != DECIMAL ? get_format_prefix(format) : "");
+    } else {
+      format_result_label(label, sizeof(label), sequence_label, limit, format, raw_output, sign);
+      written = fprintf(output, "%s", label);
+    }
+
+    if (written < 0) {
+      free(result_str);
       if (output != stdout) {
         fclose(output);
       }
@@ -653,7 +1964,10 @@ int main(int argc, char *argv[]) {
               format == DECIMAL ? "decimal" : (format == HEXADECIMAL ? "hexadecimal" : "binary"));
     }
 
-    if (fprintf(output, "%s\n", result_str) < 0) {
+    if (FIB_PROBE_ENABLED(output__write)) {
+      FIB_PROBE1(output__write, (long) strlen(digits) + 1);
+    }
+    if (fprintf(output, "%s\n", digits) < 0) {
       free(result_str);
       if (output != stdout) {
         fclose(output);
@@ -663,16 +1977,67 @@ int main(int argc, char *argv[]) {
       return EXIT_FAILURE;
     }
 
-    // Add to history before freeing result_str
-    const double time_taken = ((double) (end_time - start_time)) / (double) CLOCKS_PER_SEC;
-    add_to_history(limit, algo, format, time_taken, result_str);
+    if (render_cache) {
+      render_cache_store(limit, format, raw_output, label, digits, cache_budget, verbose);
+      cache_lock_release(render_lock);
+      render_lock = NULL;
+    }
+
+    // Hash and count the digits that were just written
+    if (digit_sinks) {
+      sink = digit_sink_create(digest, digit_stats, format);
+      if (sink != NULL) {
+        digit_sink_update(sink, digits, strlen(digits));
+      }
+    }
+
+    // Add to history before freeing result_str (only full Fibonacci results are recorded)
+    if (window_len == 0 && recurrence_spec == NULL) {
+      phase_timer_begin(&timer, PHASE_HISTORY);
+      add_to_history(limit, algo, format, time_taken, result_str);
+      phase_timer_begin(&timer, PHASE_OUTPUT);
+    }
 
     free(result_str);
   }
 
-  // Step 12: Write timing information if requested
+  // Step 14: Write digest, digit statistics and verification reports
+  memory_set_phase(ALLOC_PHASE_OUTPUT);
+  phase_timer_begin(&timer, PHASE_OUTPUT);
+  if (digit_sinks) {
+    // Without written output, stream the digits straight into the sinks
+    if (sink == NULL && time_only) {
+      sink = digit_sink_create(digest, digit_stats, format);
+      if (sink != NULL && digit_sink_stream(sink, result, verbose) != 0) {
+        digit_sink_free(sink);
+        sink = NULL;
+      }
+    }
+    if (sink == NULL || digit_sink_report(sink, output, raw_output) != 0) {
+      digit_sink_free(sink);
+      if (output != stdout) {
+        fclose(output);
+      }
+      mpz_clear(result);
+      cleanup_resources(output_file, free_args, argc, argv);
+      return EXIT_FAILURE;
+    }
+    digit_sink_free(sink);
+  }
+
+  if (verify && !raw_output) {
+    if (fprintf(output, "Verification: passed\n") < 0) {
+      if (output != stdout) {
+        fclose(output);
+      }
+      mpz_clear(result);
+      cleanup_resources(output_file, free_args, argc, argv);
+      return EXIT_FAILURE;
+    }
+  }
+
+  // Step 15: Write timing information if requested
   if (show_time) {
-    const double time_taken = ((double) (end_time - start_time)) / (double) CLOCKS_PER_SEC;
     if (fprintf(output, "Calculation Time: %lf seconds\n", time_taken) < 0) {
       if (output != stdout) {
         fclose(output);
@@ -687,33 +2052,53 @@ int main(int argc, char *argv[]) {
     }
   }
 
-  // Step 13: Close output file if we opened one
-  if (output != stdout) {
-    if (verbose) {
-      fprintf(stderr, "Closing output file\n");
-    }
-
-    if (fclose(output) != 0) {
-      perror("Error closing output file");
+  if (memory_budget > 0 && !raw_output) {
+    if (fprintf(output, "Predicted Peak Memory: %.1f MiB\nActual Peak Memory: %.1f MiB\n",
+                (double) predicted_peak / (1 << 20),
+                (double) memory_peak_resident() / (1 << 20)) < 0) {
+      if (output != stdout) {
+        fclose(output);
+      }
       mpz_clear(result);
       cleanup_resources(output_file, free_args, argc, argv);
       return EXIT_FAILURE;
     }
   }
-  // Flush stdout to ensure all output is written
-  else {
-    if (fflush(stdout) == EOF) {
-      mpz_clear(result);
-      cleanup_resources(output_file, free_args, argc, argv);
-      return EXIT_FAILURE;
+
+  // Step 16: Close output file if we opened one, otherwise flush stdout
+  if (close_output_stream(output, verbose) != 0) {
+    mpz_clear(result);
+    cleanup_resources(output_file, free_args, argc, argv);
+    return EXIT_FAILURE;
+  }
+
+  if (out_of_core_dir != NULL) {
+    memory_report_files();
+  }
+  phase_timer_end(&timer);
+  if (alloc_stats) {
+    memory_report_allocations(stderr, alloc_stats_json);
+  }
+  if (timing_json) {
+    const char *engine = algorithm_to_string(algo);
+    if (recurrence_spec != NULL) {
+      engine = "recurrence";
+    } else if (checkpointed) {
+      engine = "checkpoint";
+    } else if (low_memory) {
+      engine = "low-memory";
     }
+    phase_timer_report_json(&timer, stderr, limit, engine, format, result);
+  } else if (perf_counters) {
+    phase_timer_report_counters(&timer, stderr);
   }
+  phase_timer_close_counters(&timer);
 
   if (verbose) {
     fprintf(stderr, "Cleaning up memory\n");
   }
 
-  // Step 14: Clean up allocated memory and resources
+  // Step 17: Clean up allocated memory and resources
   mpz_clear(result);
 
   cleanup_resources(output_file, free_args, argc, argv);
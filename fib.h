@@ -2,6 +2,8 @@
 #define FIB_H
 
 #include <gmp.h>
+#include <stdint.h>
+#include <stdio.h>
 #include <time.h>
 
 // Include build ID if available
@@ -18,6 +20,57 @@
 
 typedef enum { ITERATIVE, RECURSIVE, MATRIX } Algorithm;
 typedef enum { DECIMAL, HEXADECIMAL, BINARY } OutputFormat;
+typedef enum { DIGEST_NONE, DIGEST_SHA256, DIGEST_XXH64 } DigestKind;
+typedef enum { AGGREGATE_SUM, AGGREGATE_SUM_SQUARES, AGGREGATE_ALTERNATING } AggregateKind;
+typedef enum {
+  ALLOC_PHASE_COMPUTE,
+  ALLOC_PHASE_CONVERSION,
+  ALLOC_PHASE_OUTPUT,
+  ALLOC_PHASES
+} AllocPhase;
+typedef enum {
+  PHASE_PARSE,
+  PHASE_COMPUTE,
+  PHASE_VERIFY,
+  PHASE_CONVERSION,
+  PHASE_OUTPUT,
+  PHASE_HISTORY,
+  PHASES
+} Phase;
+typedef enum {
+  COUNTER_CYCLES,
+  COUNTER_INSTRUCTIONS,
+  COUNTER_LLC_MISSES,
+  COUNTER_DTLB_MISSES,
+  COUNTER_BRANCH_MISSES,
+  COUNTERS
+} Counter;
+typedef enum { PROGRESS_LINEAR, PROGRESS_QUADRATIC, PROGRESS_DOUBLING } ProgressModel;
+
+// Order-k linear recurrence a(n) = c1 a(n-1) + ... + ck a(n-k) with seeds a(0) .. a(k-1)
+typedef struct {
+  const char *label;  // Output label, e.g. "Lucas Number"
+  long order;
+  mpz_t *coefficients;
+  mpz_t *seeds;
+} Recurrence;
+
+// Wall, calling-thread CPU and process CPU time spent in each phase of a run
+typedef struct {
+  double wall_seconds[PHASES];
+  double thread_cpu_seconds[PHASES];
+  double process_cpu_seconds[PHASES];
+  int current;  // running phase, or -1
+  double wall_start;
+  double thread_cpu_start;
+  double process_cpu_start;
+  double trace_start;  // each phase is also a trace span
+  // Hardware counters from perf_event_open, read at the same boundaries; fd -1 when the
+  // counter could not be opened
+  int counter_fds[COUNTERS];
+  uint64_t counts[PHASES][COUNTERS];
+  uint64_t counter_start[COUNTERS][3];  // value, time enabled, time running
+} PhaseTimer;
 
 #define MAX_HISTORY_ENTRIES 100
 
@@ -33,6 +86,9 @@ typedef struct {
 void calculate_fibonacci_iterative(mpz_t result, long n, int verbose);
 void calculate_fibonacci_recursive(mpz_t result, long n, void *unused, int verbose);
 void calculate_fibonacci_matrix(mpz_t result, long n, int verbose);
+void calculate_fibonacci_low_memory(mpz_t result, long n, int verbose);
+void calculate_fibonacci_pair(mpz_t fn, mpz_t fn1, long n, int verbose);
+void calculate_fibonacci_pair_mod(mpz_t fn, mpz_t fn1, long n, const mpz_t modulus);
 
 void matrix_multiply(mpz_t a11, mpz_t a12, mpz_t a21, mpz_t a22, mpz_t b11, mpz_t b12, mpz_t b21,
                      mpz_t b22, mpz_t c11, mpz_t c12, mpz_t c21, mpz_t c22);
@@ -40,9 +96,140 @@ void matrix_multiply(mpz_t a11, mpz_t a12, mpz_t a21, mpz_t a22, mpz_t b11, mpz_
 void matrix_power(mpz_t a11, mpz_t a12, mpz_t a21, mpz_t a22, long n, mpz_t result11,
                   mpz_t result12, mpz_t result21, mpz_t result22, int verbose);
 
+// Binet-formula estimates that avoid materializing F(n)
+int fibonacci_leading_digits(mpz_t leading, size_t *digit_count, long n, unsigned long k,
+                             int base, int verbose);
+int fibonacci_digit_count(size_t *digit_count, long n, int base, int verbose);
+
+// Random-access digit extraction
+char *fibonacci_digit_window(mpz_t value, long n, unsigned long pos, unsigned long len,
+                             OutputFormat format, int verbose);
+
+// Inverse lookup: index of a Fibonacci number, or -1 if value is not one
+long fibonacci_index_of(const mpz_t value, int verbose);
+
+// Zeckendorf decomposition; digits[i] is the coefficient of F(i + 2)
+unsigned char *zeckendorf_representation(const mpz_t value, size_t *count, int verbose);
+
+// Closed-form range aggregates over F(a..b); modulus may be NULL
+int fibonacci_aggregate(mpz_t result, AggregateKind kind, long a, long b, const mpz_t modulus,
+                        int verbose);
+
+// Streaming digest and digit histogram over the formatted digits of a result
+typedef struct DigitSink DigitSink;
+DigitSink *digit_sink_create(DigestKind digest, int count_digits, OutputFormat format);
+void digit_sink_tee(DigitSink *sink, FILE *output);
+const char *digit_sink_head(const DigitSink *sink);
+void digit_sink_update(DigitSink *sink, const char *digits, size_t len);
+int digit_sink_stream(DigitSink *sink, const mpz_t value, int verbose);
+int digit_sink_report(DigitSink *sink, FILE *output, int raw_output);
+void digit_sink_free(DigitSink *sink);
+unsigned long long digest_xxh64(const void *data, size_t len);
+
+// Parallel search for probable-prime F(n) over an index range, resumable via a state file;
+// once calculation_cancelled is set it returns without waiting for the tests in flight and
+// prints no results
+int fibonacci_prime_search(long a, long b, int threads, const char *state_path, FILE *output,
+                           int raw_output, int verbose);
+
+// Modular fingerprint check of a computed F(n); 0 if it passes
+int fibonacci_verify(const mpz_t result, long n, int verbose);
+
+// Generic linear recurrences: "c1,...,ck;s0,...,sk-1" or a preset name such as "lucas"
+int recurrence_parse(Recurrence *rec, const char *spec);
+void recurrence_clear(Recurrence *rec);
+int calculate_recurrence(mpz_t result, const Recurrence *rec, long n, int verbose);
+
+// Persistent cache of (F(k), F(k + 1)) pairs; computes F(n) from the nearest usable entry
+void calculate_fibonacci_cached(mpz_t result, long n, Algorithm algo,
+                                unsigned long long budget_bytes, int verbose);
+
+// Rendered-output cache: the exact bytes written for F(n) in one format and label style
+int render_cache_open(long n, OutputFormat format, int raw_output, int verbose);
+int render_cache_send(int fd, FILE *output, size_t digits_offset, char preview[65]);
+void render_cache_store(long n, OutputFormat format, int raw_output, const char *label,
+                        const char *digits, unsigned long long budget_bytes, int verbose);
+
+// Cross-process single flight: one process computes a key while the others wait on its flock
+typedef struct CacheLock CacheLock;
+CacheLock *render_cache_lock(long n, OutputFormat format, int raw_output, int verbose);
+void cache_lock_release(CacheLock *lock);
+
+// Fast doubling that periodically writes its state (F(k), F(k + 1)) from a background thread
+int calculate_fibonacci_checkpointed(mpz_t result, long n, const char *checkpoint_path,
+                                     double interval, const char *resume_path, int verbose);
+
+// Out-of-core mode: large GMP blocks in unlinked file-backed mappings under dir
+int memory_use_files(const char *dir, unsigned long long resident_budget, int verbose);
+void memory_report_files(void);
+
+// Arena allocator: per-thread size classes for small GMP blocks, huge-page mappings for large
+int memory_use_arena(int verbose);
+void memory_arena_reset(void);
+
+// Allocation statistics through GMP's memory hooks, installed only when requested
+void memory_track_allocations(void);
+void memory_set_phase(AllocPhase phase);
+int memory_report_allocations(FILE *output, int json);
+
+// Peak-memory model of the engines and output paths, and the measured peak so far
+size_t memory_predict_peak(long n, Algorithm algo, OutputFormat format, int write_digits,
+                           int low_memory);
+size_t memory_peak_resident(void);
+
+// Phase timing on the monotonic and CPU-time clocks
+double monotonic_seconds(void);
+void phase_timer_init(PhaseTimer *timer);
+void phase_timer_begin(PhaseTimer *timer, Phase phase);
+void phase_timer_end(PhaseTimer *timer);
+int phase_timer_enable_counters(PhaseTimer *timer);
+void phase_timer_close_counters(PhaseTimer *timer);
+int phase_timer_report_json(const PhaseTimer *timer, FILE *output, long n, const char *engine,
+                            OutputFormat format, const mpz_t result);
+int phase_timer_report_counters(const PhaseTimer *timer, FILE *output);
+int phase_timer_report_text(const PhaseTimer *timer, FILE *output);
+
+// Progress of the running engine: the engine declares its task, then its loop only bumps
+// progress_done; a reporter thread turns that into rate-limited updates and SIGUSR1 dumps.
+// Between tasks a dump names the phase of the run set by progress_phase().
+// Engine loops also stop early once calculation_cancelled is set, by calculation_cancel() or
+// by the reporter at its deadline; the result is then meaningless
+extern long progress_done;
+extern int calculation_cancelled;
+#define PROGRESS_ADVANCE() ((void) __atomic_add_fetch(&progress_done, 1, __ATOMIC_RELAXED))
+#define CALCULATION_CANCELLED() __atomic_load_n(&calculation_cancelled, __ATOMIC_RELAXED)
+void progress_begin(const char *task, const char *unit, long total, ProgressModel model);
+void progress_end(void);
+void progress_phase(const char *name);
+int progress_report(FILE *output);
+void calculation_cancel(void);
+void calculation_reset(void);
+void progress_install_handler(void);
+int progress_start_reporter(int verbose, double deadline);
+void progress_set_deadline(double deadline);
+void progress_stop_reporter(void);
+
+// Chrome trace-event spans: trace_begin() stamps a start, trace_end() records the span with up
+// to two named arguments. Timestamps count from origin, a monotonic_seconds() value, and
+// trace_begin_at() stamps a span that started before the trace was opened. Building with
+// -DFIB_NO_TRACE compiles every call away
+#ifndef FIB_NO_TRACE
+int trace_open(const char *path, double origin);
+double trace_begin(void);
+double trace_begin_at(double seconds);
+void trace_end(const char *name, double start, const char *arg_name, long arg,
+               const char *arg2_name, long arg2);
+#else
+#define trace_open(path, origin) ((void) (path), (void) (origin), -1)
+#define trace_begin() 0.0
+#define trace_begin_at(seconds) ((void) (seconds), 0.0)
+#define trace_end(name, start, arg_name, arg, arg2_name, arg2) ((void) (start))
+#endif
+
 void display_help(const char *program_name);
 char *get_formatted_result(mpz_t result, OutputFormat format, int verbose);
 const char *get_format_prefix(OutputFormat format);
+int read_big_integer(mpz_t value, const char *spec);
 
 void run_user_interface(int *argc, char ***argv);
 void free_generated_args(int argc, char **argv);
@@ -53,6 +240,7 @@ int save_history(const HistoryEntry *history, int count);
 int add_to_history(long fib_number, Algorithm algorithm, OutputFormat format, double calc_time,
                    const char *result_str);
 void display_history(void);
+char *get_cache_directory(void);
 const char *algorithm_to_string(Algorithm algo);
 const char *format_to_string(OutputFormat fmt);
 
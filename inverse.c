@@ -0,0 +1,57 @@
+#include "fib.h"
+#include <math.h>
+#include <stdio.h>
+
+long fibonacci_index_of(const mpz_t value, int verbose) {
+  if (mpz_sgn(value) < 0) {
+    return -1;
+  }
+  // F(1) = F(2) = 1; report the smallest index
+  if (mpz_cmp_ui(value, 1) <= 0) {
+    return (long) mpz_get_ui(value);
+  }
+
+  // x is Fibonacci iff 5x^2 + 4 (even index) or 5x^2 - 4 (odd index) is a perfect square
+  mpz_t test;
+  mpz_init(test);
+  mpz_mul(test, value, value);
+  mpz_mul_ui(test, test, 5);
+  mpz_add_ui(test, test, 4);
+
+  int parity = -1;
+  if (mpz_perfect_square_p(test)) {
+    parity = 0;
+  } else {
+    mpz_sub_ui(test, test, 8);
+    if (mpz_perfect_square_p(test)) {
+      parity = 1;
+    }
+  }
+  mpz_clear(test);
+
+  if (parity < 0) {
+    if (verbose) {
+      fprintf(stderr, "Neither 5x^2 + 4 nor 5x^2 - 4 is a perfect square\n");
+    }
+    return -1;
+  }
+
+  // n = log_phi(x * sqrt(5)) up to a vanishing psi^n term; x = mantissa * 2^exponent
+  long exponent;
+  double mantissa = mpz_get_d_2exp(&exponent, value);
+  double estimate = (log(mantissa) + (double) exponent * log(2.0) + 0.5 * log(5.0)) /
+                    log((1.0 + sqrt(5.0)) / 2.0);
+
+  // Knowing the parity from the square test, any estimate within +-1 pins the exact index
+  long candidate = (long) floor(estimate);
+  if ((candidate & 1) != parity) {
+    candidate++;
+  }
+
+  if (verbose) {
+    fprintf(stderr, "Estimated index %.3f, %s index %ld\n", estimate, parity ? "odd" : "even",
+            candidate);
+  }
+
+  return candidate;
+}
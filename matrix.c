@@ -1,8 +1,11 @@
 #include "fib.h"
+#include "probes.h"
 #include <stdio.h>
 
 void matrix_multiply(mpz_t a11, mpz_t a12, mpz_t a21, mpz_t a22, mpz_t b11, mpz_t b12, mpz_t b21,
                      mpz_t b22, mpz_t c11, mpz_t c12, mpz_t c21, mpz_t c22) {
+  double span = trace_begin();
+  FIB_PROBE2(matrix__multiply__start, (long) mpz_size(a11), (long) mpz_size(b11));
   mpz_t temp1, temp2;
   mpz_init(temp1);
   mpz_init(temp2);
@@ -25,6 +28,9 @@ void matrix_multiply(mpz_t a11, mpz_t a12, mpz_t a21, mpz_t a22, mpz_t b11, mpz_
 
   mpz_clear(temp1);
   mpz_clear(temp2);
+  FIB_PROBE1(matrix__multiply__done, (long) mpz_size(c11));
+  trace_end("matrix_multiply", span, "a_limbs", (long) mpz_size(a11), "b_limbs",
+            (long) mpz_size(b11));
 }
 
 void matrix_power(mpz_t a11, mpz_t a12, mpz_t a21, mpz_t a22, long n, mpz_t result11,
@@ -45,10 +51,7 @@ void matrix_power(mpz_t a11, mpz_t a12, mpz_t a21, mpz_t a22, long n, mpz_t resu
     return;
   }
 
-  if (verbose && (n % 50 == 0)) {
-    fprintf(stderr, "Computing matrix power %ld...\n", n);
-  }
-
+  double span = trace_begin();
   mpz_t temp11, temp12, temp21, temp22;
   mpz_init(temp11);
   mpz_init(temp12);
@@ -57,16 +60,25 @@ void matrix_power(mpz_t a11, mpz_t a12, mpz_t a21, mpz_t a22, long n, mpz_t resu
 
   if (n % 2 == 0) {
     matrix_power(a11, a12, a21, a22, n / 2, temp11, temp12, temp21, temp22, verbose);
-    matrix_multiply(temp11, temp12, temp21, temp22, temp11, temp12, temp21, temp22, result11,
-                    result12, result21, result22);
   } else {
     matrix_power(a11, a12, a21, a22, n - 1, temp11, temp12, temp21, temp22, verbose);
-    matrix_multiply(a11, a12, a21, a22, temp11, temp12, temp21, temp22, result11, result12,
-                    result21, result22);
+  }
+
+  // Once cancelled, the pending levels unwind without multiplying
+  if (!CALCULATION_CANCELLED()) {
+    if (n % 2 == 0) {
+      matrix_multiply(temp11, temp12, temp21, temp22, temp11, temp12, temp21, temp22, result11,
+                      result12, result21, result22);
+      PROGRESS_ADVANCE();
+    } else {
+      matrix_multiply(a11, a12, a21, a22, temp11, temp12, temp21, temp22, result11, result12,
+                      result21, result22);
+    }
   }
 
   mpz_clear(temp11);
   mpz_clear(temp12);
   mpz_clear(temp21);
   mpz_clear(temp22);
+  trace_end("matrix_power", span, "n", n, "limbs", (long) mpz_size(result12));
 }
@@ -0,0 +1,857 @@
+#ifdef __linux__
+#define _GNU_SOURCE  // mremap
+#endif
+
+#include "fib.h"
+#include <fcntl.h>
+#include <pthread.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/resource.h>
+#include <unistd.h>
+
+// GMP blocks at least this large live in their own file-backed segment
+#define SEGMENT_MIN_BYTES (1UL << 20)
+
+// Room in front of each segment for its bookkeeping; keeps limbs cache-line aligned
+#define SEGMENT_HEADER_BYTES 64
+
+typedef struct Segment {
+  struct Segment *prev;  // allocation order, oldest first
+  struct Segment *next;
+  size_t length;         // mapped bytes including this header
+  size_t resident;       // bytes in memory as of the last allocator call
+  int fd;
+} Segment;
+
+typedef struct {
+  char *dir;
+  unsigned long long resident_budget;
+  unsigned long long mapped_bytes;
+  unsigned long long resident_bytes;
+  unsigned long long peak_mapped_bytes;
+  Segment *oldest;
+  Segment *newest;
+  int verbose;
+  pthread_mutex_t lock;
+} SegmentPool;
+
+static SegmentPool pool = {NULL, 0, 0, 0, 0, NULL, NULL, 0, PTHREAD_MUTEX_INITIALIZER};
+
+static Segment *segment_of(void *ptr) {
+  return (Segment *) ((char *) ptr - SEGMENT_HEADER_BYTES);
+}
+
+static void segment_link(Segment *segment) {
+  segment->prev = pool.newest;
+  segment->next = NULL;
+  if (pool.newest != NULL) {
+    pool.newest->next = segment;
+  } else {
+    pool.oldest = segment;
+  }
+  pool.newest = segment;
+}
+
+static void segment_unlink(Segment *segment) {
+  if (segment->prev != NULL) {
+    segment->prev->next = segment->next;
+  } else {
+    pool.oldest = segment->next;
+  }
+  if (segment->next != NULL) {
+    segment->next->prev = segment->prev;
+  } else {
+    pool.newest = segment->prev;
+  }
+}
+
+/**
+ * Counts the bytes of a segment that are in memory. GMP reads and writes the limbs directly,
+ * so a segment paged out earlier only shows up here again once it has been faulted back in.
+ */
+static size_t segment_resident_bytes(const Segment *segment) {
+  static unsigned char pages[4096];  // guarded by the pool lock
+  size_t page = (size_t) sysconf(_SC_PAGESIZE);
+  size_t window = sizeof(pages) * page;
+  size_t resident = 0;
+  for (size_t offset = 0; offset < segment->length; offset += window) {
+    size_t span = segment->length - offset < window ? segment->length - offset : window;
+    if (mincore((char *) segment + offset, span, pages) != 0) {
+      return segment->length;
+    }
+    for (size_t i = 0; i < (span + page - 1) / page; i++) {
+      resident += pages[i] & 1;
+    }
+  }
+  resident *= page;
+  return resident < segment->length ? resident : segment->length;
+}
+
+/**
+ * Brings the resident estimate up to date before it is compared with the budget.
+ */
+static void segment_sample(void) {
+  pool.resident_bytes = 0;
+  for (Segment *s = pool.oldest; s != NULL; s = s->next) {
+    s->resident = segment_resident_bytes(s);
+    pool.resident_bytes += s->resident;
+  }
+}
+
+/**
+ * Pushes the oldest resident segments out to their files until the resident estimate fits
+ * the budget. Dirty pages are written back and the process mapping dropped; the data is read
+ * back from the page cache or the file on the next access. Called with the pool lock held.
+ */
+static void segment_trim(Segment *keep) {
+  for (Segment *s = pool.oldest; s != NULL && pool.resident_bytes > pool.resident_budget;
+       s = s->next) {
+    if (s->resident == 0 || s == keep) {
+      continue;
+    }
+    char *data = (char *) s;
+#ifdef MADV_PAGEOUT
+    madvise(data, s->length, MADV_PAGEOUT);
+#else
+    // Without MADV_PAGEOUT the pages also have to leave the page cache, or they still count
+    msync(data, s->length, MS_SYNC);
+    madvise(data, s->length, MADV_DONTNEED);
+    posix_fadvise(s->fd, 0, (off_t) s->length, POSIX_FADV_DONTNEED);
+#endif
+    pool.resident_bytes -= s->resident;
+    s->resident = 0;
+  }
+}
+
+static void segment_account(Segment *segment) {
+  pool.mapped_bytes += segment->length;
+  if (pool.mapped_bytes > pool.peak_mapped_bytes) {
+    pool.peak_mapped_bytes = pool.mapped_bytes;
+  }
+  // The new or resized segment is about to be written in full
+  segment_sample();
+  pool.resident_bytes += segment->length - segment->resident;
+  segment->resident = segment->length;
+  segment_trim(segment);
+}
+
+static void segment_unaccount(Segment *segment) {
+  pool.resident_bytes -= segment->resident;
+  pool.mapped_bytes -= segment->length;
+}
+
+/**
+ * Maps a new segment backed by an unlinked temporary file, so nothing is left behind on disk
+ * however the process ends.
+ */
+static void *segment_alloc(size_t size) {
+  size_t length = size + SEGMENT_HEADER_BYTES;
+  size_t path_len = strlen(pool.dir) + 32;
+  char *path = malloc(path_len);
+  if (path == NULL) {
+    return NULL;
+  }
+  snprintf(path, path_len, "%s/fib-segment-XXXXXX", pool.dir);
+  int fd = mkstemp(path);
+  if (fd != -1) {
+    unlink(path);
+  }
+  free(path);
+  if (fd == -1) {
+    return NULL;
+  }
+
+  void *base = MAP_FAILED;
+  if (ftruncate(fd, (off_t) length) == 0) {
+    base = mmap(NULL, length, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+  }
+  if (base == MAP_FAILED) {
+    close(fd);
+    return NULL;
+  }
+
+  Segment *segment = base;
+  segment->length = length;
+  segment->fd = fd;
+  pthread_mutex_lock(&pool.lock);
+  segment_link(segment);
+  segment_account(segment);
+  pthread_mutex_unlock(&pool.lock);
+  return (char *) base + SEGMENT_HEADER_BYTES;
+}
+
+static void segment_free(void *ptr) {
+  Segment *segment = segment_of(ptr);
+  pthread_mutex_lock(&pool.lock);
+  segment_unlink(segment);
+  segment_unaccount(segment);
+  pthread_mutex_unlock(&pool.lock);
+  int fd = segment->fd;
+  munmap(segment, segment->length);
+  close(fd);
+}
+
+static void out_of_memory(size_t size) {
+  fprintf(stderr, "Error: Cannot allocate %zu bytes\n", size);
+  abort();
+}
+
+static void *ooc_alloc(size_t size) {
+  void *ptr = size >= SEGMENT_MIN_BYTES ? segment_alloc(size) : malloc(size);
+  if (ptr == NULL) {
+    out_of_memory(size);
+  }
+  return ptr;
+}
+
+static void ooc_free(void *ptr, size_t size) {
+  if (size >= SEGMENT_MIN_BYTES) {
+    segment_free(ptr);
+  } else {
+    free(ptr);
+  }
+}
+
+static void *ooc_realloc(void *ptr, size_t old_size, size_t new_size) {
+  if (old_size < SEGMENT_MIN_BYTES && new_size < SEGMENT_MIN_BYTES) {
+    void *resized = realloc(ptr, new_size);
+    if (resized == NULL) {
+      out_of_memory(new_size);
+    }
+    return resized;
+  }
+
+#ifdef __linux__
+  // Grow or shrink the file and let the kernel move the mapping without copying
+  if (old_size >= SEGMENT_MIN_BYTES && new_size >= SEGMENT_MIN_BYTES) {
+    Segment *segment = segment_of(ptr);
+    size_t length = new_size + SEGMENT_HEADER_BYTES;
+    pthread_mutex_lock(&pool.lock);
+    segment_unlink(segment);
+    segment_unaccount(segment);
+    void *base = MAP_FAILED;
+    if (ftruncate(segment->fd, (off_t) length) == 0) {
+      base = mremap(segment, segment->length, length, MREMAP_MAYMOVE);
+    }
+    if (base == MAP_FAILED) {
+      pthread_mutex_unlock(&pool.lock);
+      out_of_memory(new_size);
+    }
+    segment = base;
+    segment->length = length;
+    segment_link(segment);
+    segment_account(segment);
+    pthread_mutex_unlock(&pool.lock);
+    return (char *) base + SEGMENT_HEADER_BYTES;
+  }
+#endif
+
+  void *moved = ooc_alloc(new_size);
+  memcpy(moved, ptr, old_size < new_size ? old_size : new_size);
+  ooc_free(ptr, old_size);
+  return moved;
+}
+
+int memory_use_files(const char *dir, unsigned long long resident_budget, int verbose) {
+  pool.dir = realpath(dir, NULL);
+  if (pool.dir == NULL) {
+    return -1;
+  }
+  pool.resident_budget = resident_budget;
+  pool.verbose = verbose;
+  mp_set_memory_functions(ooc_alloc, ooc_realloc, ooc_free);
+  if (verbose) {
+    fprintf(stderr, "Keeping GMP blocks of %lu bytes or more in files under %s\n",
+            SEGMENT_MIN_BYTES, pool.dir);
+  }
+  return 0;
+}
+
+void memory_report_files(void) {
+  if (pool.dir != NULL && pool.verbose) {
+    fprintf(stderr, "Peak file-backed memory: %llu bytes (resident budget %llu bytes)\n",
+            pool.peak_mapped_bytes, pool.resident_budget);
+  }
+}
+
+// Arena allocator: small blocks come from per-thread size-class free lists carved out of
+// huge-page sized chunks, large blocks get their own 2 MiB aligned mapping
+#define HUGE_PAGE_BYTES (2UL << 20)
+#define ARENA_CHUNK_BYTES HUGE_PAGE_BYTES
+#define ARENA_MIN_CLASS_SHIFT 5  // 32-byte blocks, header included
+#define ARENA_CLASSES 14         // up to 256 KiB
+#define ARENA_MAX_CLASS_BYTES (1UL << (ARENA_MIN_CLASS_SHIFT + ARENA_CLASSES - 1))
+#define ARENA_BLOCK_HEADER_BYTES 16
+#define ARENA_LARGE_HEADER_BYTES 64
+#define ARENA_SPARE_MAPPINGS 8
+
+typedef struct ArenaChunk {
+  struct ArenaChunk *next;
+} ArenaChunk;
+
+typedef struct Arena {
+  ArenaChunk *chunks;  // newest first; the bump region is the tail of the first
+  char *bump;
+  char *bump_end;
+  void *free_lists[ARENA_CLASSES];
+  void *remote_frees;                // blocks freed by other threads, pushed lock-free
+  unsigned long long allocated;      // owner thread only
+  unsigned long long freed;          // owner thread only
+  unsigned long long remote_freed;   // atomic
+} Arena;
+
+// Every small block starts with its owner and class so any thread can return it
+typedef struct {
+  Arena *owner;
+  size_t size_class;
+} ArenaBlock;
+
+// Large blocks remember their mapping so realloc can grow in place up to its end
+typedef struct {
+  size_t length;  // mapped bytes including this header
+} LargeBlock;
+
+// Recently freed large mappings, reused to skip the page faults of mapping fresh memory
+typedef struct {
+  LargeBlock *blocks[ARENA_SPARE_MAPPINGS];
+  int count;
+  pthread_mutex_t lock;
+} SpareMappings;
+
+static SpareMappings spare = {{NULL}, 0, PTHREAD_MUTEX_INITIALIZER};
+static pthread_key_t arena_key;
+static pthread_once_t arena_once = PTHREAD_ONCE_INIT;
+static int arena_installed = 0;
+static int arena_verbose = 0;
+
+/**
+ * Maps length bytes (a multiple of HUGE_PAGE_BYTES) at a HUGE_PAGE_BYTES boundary, so the
+ * kernel can back them with transparent huge pages, and asks it to.
+ */
+static void *map_huge_aligned(size_t length) {
+  size_t padded = length + HUGE_PAGE_BYTES;
+  char *base = mmap(NULL, padded, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+  if (base == MAP_FAILED) {
+    return NULL;
+  }
+  uintptr_t addr = (uintptr_t) base;
+  uintptr_t aligned = (addr + HUGE_PAGE_BYTES - 1) & ~((uintptr_t) HUGE_PAGE_BYTES - 1);
+  size_t head = (size_t) (aligned - addr);
+  if (head > 0) {
+    munmap(base, head);
+  }
+  munmap((char *) aligned + length, padded - head - length);
+#ifdef MADV_HUGEPAGE
+  madvise((void *) aligned, length, MADV_HUGEPAGE);
+#endif
+  return (void *) aligned;
+}
+
+static size_t round_to_huge_pages(size_t bytes) {
+  return (bytes + HUGE_PAGE_BYTES - 1) & ~(HUGE_PAGE_BYTES - 1);
+}
+
+static void arena_release(Arena *arena) {
+  ArenaChunk *chunk = arena->chunks;
+  while (chunk != NULL) {
+    ArenaChunk *next = chunk->next;
+    munmap(chunk, ARENA_CHUNK_BYTES);
+    chunk = next;
+  }
+  free(arena);
+}
+
+static unsigned long long arena_live_blocks(Arena *arena) {
+  return arena->allocated - arena->freed -
+         __atomic_load_n(&arena->remote_freed, __ATOMIC_ACQUIRE);
+}
+
+/**
+ * Runs when a thread exits. Its arena can only go away once nothing allocated from it is
+ * live, since a block may outlive its thread (mpz values are handed between threads); such
+ * an arena is left in place for the remaining blocks to be returned to.
+ */
+static void arena_thread_exit(void *arg) {
+  Arena *arena = arg;
+  if (arena_live_blocks(arena) == 0) {
+    arena_release(arena);
+  }
+}
+
+static void arena_create_key(void) {
+  pthread_key_create(&arena_key, arena_thread_exit);
+}
+
+static Arena *arena_current(void) {
+  Arena *arena = pthread_getspecific(arena_key);
+  if (arena == NULL) {
+    arena = calloc(1, sizeof(Arena));
+    if (arena != NULL) {
+      pthread_setspecific(arena_key, arena);
+    }
+  }
+  return arena;
+}
+
+/**
+ * Moves blocks other threads have returned onto the owner's free lists.
+ */
+static void arena_collect_remote(Arena *arena) {
+  void *block = __atomic_exchange_n(&arena->remote_frees, NULL, __ATOMIC_ACQUIRE);
+  while (block != NULL) {
+    void *next = *(void **) ((char *) block + ARENA_BLOCK_HEADER_BYTES);
+    size_t size_class = ((ArenaBlock *) block)->size_class;
+    *(void **) ((char *) block + ARENA_BLOCK_HEADER_BYTES) = arena->free_lists[size_class];
+    arena->free_lists[size_class] = block;
+    block = next;
+  }
+}
+
+static size_t arena_class_of(size_t size) {
+  size_t bytes = size + ARENA_BLOCK_HEADER_BYTES;
+  size_t size_class = 0;
+  while (((size_t) 1 << (ARENA_MIN_CLASS_SHIFT + size_class)) < bytes) {
+    size_class++;
+  }
+  return size_class;
+}
+
+static void *arena_small_alloc(size_t size) {
+  Arena *arena = arena_current();
+  if (arena == NULL) {
+    return NULL;
+  }
+  size_t size_class = arena_class_of(size);
+  char *block = arena->free_lists[size_class];
+  if (block == NULL && arena->remote_frees != NULL) {
+    arena_collect_remote(arena);
+    block = arena->free_lists[size_class];
+  }
+
+  if (block != NULL) {
+    arena->free_lists[size_class] = *(void **) (block + ARENA_BLOCK_HEADER_BYTES);
+  } else {
+    size_t bytes = (size_t) 1 << (ARENA_MIN_CLASS_SHIFT + size_class);
+    if (arena->bump == NULL || (size_t) (arena->bump_end - arena->bump) < bytes) {
+      ArenaChunk *chunk = map_huge_aligned(ARENA_CHUNK_BYTES);
+      if (chunk == NULL) {
+        return NULL;
+      }
+      chunk->next = arena->chunks;
+      arena->chunks = chunk;
+      // Blocks start after a minimum-class slot holding the link, 32-byte aligned
+      arena->bump = (char *) chunk + ((size_t) 1 << ARENA_MIN_CLASS_SHIFT);
+      arena->bump_end = (char *) chunk + ARENA_CHUNK_BYTES;
+    }
+    block = arena->bump;
+    arena->bump += bytes;
+  }
+
+  ((ArenaBlock *) (void *) block)->owner = arena;
+  ((ArenaBlock *) (void *) block)->size_class = size_class;
+  arena->allocated++;
+  return block + ARENA_BLOCK_HEADER_BYTES;
+}
+
+static void arena_small_free(void *ptr) {
+  char *block = (char *) ptr - ARENA_BLOCK_HEADER_BYTES;
+  ArenaBlock *header = (ArenaBlock *) (void *) block;
+  Arena *arena = header->owner;
+  if (arena == pthread_getspecific(arena_key)) {
+    *(void **) ptr = arena->free_lists[header->size_class];
+    arena->free_lists[header->size_class] = block;
+    arena->freed++;
+    return;
+  }
+
+  // Another thread's block: push it onto that arena's remote list for the owner to collect
+  void *head = __atomic_load_n(&arena->remote_frees, __ATOMIC_RELAXED);
+  do {
+    *(void **) ptr = head;
+  } while (!__atomic_compare_exchange_n(&arena->remote_frees, &head, block, 1, __ATOMIC_RELEASE,
+                                        __ATOMIC_RELAXED));
+  __atomic_fetch_add(&arena->remote_freed, 1, __ATOMIC_RELEASE);
+}
+
+static void *arena_large_alloc(size_t size) {
+  size_t length = round_to_huge_pages(size + ARENA_LARGE_HEADER_BYTES);
+
+  // Take the smallest spare that fits without wasting more than the request itself
+  LargeBlock *block = NULL;
+  pthread_mutex_lock(&spare.lock);
+  int best = -1;
+  for (int i = 0; i < spare.count; i++) {
+    size_t spare_length = spare.blocks[i]->length;
+    if (spare_length >= length && spare_length <= 2 * length &&
+        (best < 0 || spare_length < spare.blocks[best]->length)) {
+      best = i;
+    }
+  }
+  if (best >= 0) {
+    block = spare.blocks[best];
+    spare.blocks[best] = spare.blocks[--spare.count];
+  }
+  pthread_mutex_unlock(&spare.lock);
+  if (block != NULL) {
+    return (char *) block + ARENA_LARGE_HEADER_BYTES;
+  }
+
+  block = map_huge_aligned(length);
+  if (block == NULL) {
+    return NULL;
+  }
+  block->length = length;
+  return (char *) block + ARENA_LARGE_HEADER_BYTES;
+}
+
+static void arena_large_free(void *ptr) {
+  LargeBlock *block = (LargeBlock *) (void *) ((char *) ptr - ARENA_LARGE_HEADER_BYTES);
+
+  // Keep it as a spare, displacing the smallest one once the list is full; operands grow
+  // along the ladder, so larger mappings are the likelier to be asked for again
+  pthread_mutex_lock(&spare.lock);
+  if (spare.count < ARENA_SPARE_MAPPINGS) {
+    spare.blocks[spare.count++] = block;
+    block = NULL;
+  } else {
+    int smallest = 0;
+    for (int i = 1; i < spare.count; i++) {
+      if (spare.blocks[i]->length < spare.blocks[smallest]->length) {
+        smallest = i;
+      }
+    }
+    if (spare.blocks[smallest]->length < block->length) {
+      LargeBlock *displaced = spare.blocks[smallest];
+      spare.blocks[smallest] = block;
+      block = displaced;
+    }
+  }
+  pthread_mutex_unlock(&spare.lock);
+  if (block != NULL) {
+    munmap(block, block->length);
+  }
+}
+
+static int arena_is_small(size_t size) {
+  return size + ARENA_BLOCK_HEADER_BYTES <= ARENA_MAX_CLASS_BYTES;
+}
+
+static void *arena_alloc(size_t size) {
+  void *ptr = arena_is_small(size) ? arena_small_alloc(size) : arena_large_alloc(size);
+  if (ptr == NULL) {
+    out_of_memory(size);
+  }
+  return ptr;
+}
+
+static void arena_free(void *ptr, size_t size) {
+  if (arena_is_small(size)) {
+    arena_small_free(ptr);
+  } else {
+    arena_large_free(ptr);
+  }
+}
+
+static void *arena_realloc(void *ptr, size_t old_size, size_t new_size) {
+  // Stay in place while the block's class or mapping still has room
+  if (arena_is_small(old_size) && arena_is_small(new_size)) {
+    ArenaBlock *header = (ArenaBlock *) (void *) ((char *) ptr - ARENA_BLOCK_HEADER_BYTES);
+    if (arena_class_of(new_size) == header->size_class) {
+      return ptr;
+    }
+  } else if (!arena_is_small(old_size) && !arena_is_small(new_size)) {
+    LargeBlock *block = (LargeBlock *) (void *) ((char *) ptr - ARENA_LARGE_HEADER_BYTES);
+    if (new_size + ARENA_LARGE_HEADER_BYTES <= block->length) {
+      return ptr;
+    }
+  }
+
+  void *moved = arena_alloc(new_size);
+  memcpy(moved, ptr, old_size < new_size ? old_size : new_size);
+  arena_free(ptr, old_size);
+  return moved;
+}
+
+int memory_use_arena(int verbose) {
+  if (pool.dir != NULL) {
+    return -1;
+  }
+  pthread_once(&arena_once, arena_create_key);
+  if (!arena_installed) {
+    mp_set_memory_functions(arena_alloc, arena_realloc, arena_free);
+    arena_installed = 1;
+    arena_verbose = verbose;
+    if (verbose) {
+      fprintf(stderr,
+              "Using the arena allocator: %lu size classes up to %lu bytes, larger blocks "
+              "in %lu-byte aligned mappings\n",
+              (unsigned long) ARENA_CLASSES, ARENA_MAX_CLASS_BYTES, HUGE_PAGE_BYTES);
+    }
+  }
+  return 0;
+}
+
+void memory_arena_reset(void) {
+  if (!arena_installed) {
+    return;
+  }
+  Arena *arena = pthread_getspecific(arena_key);
+  if (arena == NULL) {
+    return;
+  }
+  pthread_mutex_lock(&spare.lock);
+  for (int i = 0; i < spare.count; i++) {
+    munmap(spare.blocks[i], spare.blocks[i]->length);
+  }
+  spare.count = 0;
+  pthread_mutex_unlock(&spare.lock);
+
+  arena_collect_remote(arena);
+  if (arena_live_blocks(arena) != 0) {
+    return;
+  }
+
+  // Nothing is live: keep the newest chunk for the next computation and drop the rest
+  ArenaChunk *keep = arena->chunks;
+  if (keep != NULL) {
+    ArenaChunk *chunk = keep->next;
+    while (chunk != NULL) {
+      ArenaChunk *next = chunk->next;
+      munmap(chunk, ARENA_CHUNK_BYTES);
+      chunk = next;
+    }
+    keep->next = NULL;
+    arena->bump = (char *) keep + ((size_t) 1 << ARENA_MIN_CLASS_SHIFT);
+    arena->bump_end = (char *) keep + ARENA_CHUNK_BYTES;
+  }
+  memset(arena->free_lists, 0, sizeof(arena->free_lists));
+  arena->allocated = 0;
+  arena->freed = 0;
+  __atomic_store_n(&arena->remote_freed, 0, __ATOMIC_RELEASE);
+  if (arena_verbose) {
+    fprintf(stderr, "Reset the arena of the calling thread\n");
+  }
+}
+
+// Allocation statistics: wrappers around whichever GMP memory functions are installed
+#define ALLOC_SIZE_BUCKETS 48  // powers of two up to 128 TiB
+
+typedef struct {
+  unsigned long long allocations;
+  unsigned long long reallocations;
+  unsigned long long bytes_allocated;
+  unsigned long long peak_live_bytes;
+} PhaseStats;
+
+typedef struct {
+  void *(*alloc)(size_t);
+  void *(*realloc)(void *, size_t, size_t);
+  void (*free)(void *, size_t);
+  unsigned long long allocations;
+  unsigned long long reallocations;
+  unsigned long long frees;
+  unsigned long long bytes_allocated;
+  unsigned long long bytes_copied;  // moved by reallocations that changed the block's address
+  unsigned long long live_bytes;
+  unsigned long long peak_live_bytes;
+  unsigned long long size_buckets[ALLOC_SIZE_BUCKETS];
+  PhaseStats phases[ALLOC_PHASES];
+  int phase;
+} AllocStats;
+
+static AllocStats stats;
+static const char *const phase_names[ALLOC_PHASES] = {"compute", "conversion", "output"};
+
+static void raise_to(unsigned long long *peak, unsigned long long value) {
+  unsigned long long seen = __atomic_load_n(peak, __ATOMIC_RELAXED);
+  while (value > seen &&
+         !__atomic_compare_exchange_n(peak, &seen, value, 1, __ATOMIC_RELAXED, __ATOMIC_RELAXED)) {
+  }
+}
+
+/**
+ * Counts a request for size bytes in its power-of-two bucket and the current phase, and moves
+ * the live total by delta. Updates are atomic since helper threads allocate too.
+ */
+static void record_request(size_t size, long long delta, int reallocation) {
+  int bucket = 0;
+  while (bucket < ALLOC_SIZE_BUCKETS - 1 && ((size_t) 1 << bucket) < size) {
+    bucket++;
+  }
+  __atomic_fetch_add(&stats.size_buckets[bucket], 1, __ATOMIC_RELAXED);
+
+  PhaseStats *phase = &stats.phases[__atomic_load_n(&stats.phase, __ATOMIC_RELAXED)];
+  __atomic_fetch_add(reallocation ? &phase->reallocations : &phase->allocations, 1,
+                     __ATOMIC_RELAXED);
+  __atomic_fetch_add(reallocation ? &stats.reallocations : &stats.allocations, 1,
+                     __ATOMIC_RELAXED);
+  if (delta > 0) {
+    __atomic_fetch_add(&phase->bytes_allocated, (unsigned long long) delta, __ATOMIC_RELAXED);
+    __atomic_fetch_add(&stats.bytes_allocated, (unsigned long long) delta, __ATOMIC_RELAXED);
+  }
+
+  unsigned long long live =
+      __atomic_add_fetch(&stats.live_bytes, (unsigned long long) delta, __ATOMIC_RELAXED);
+  raise_to(&stats.peak_live_bytes, live);
+  raise_to(&phase->peak_live_bytes, live);
+}
+
+static void *tracked_alloc(size_t size) {
+  record_request(size, (long long) size, 0);
+  return stats.alloc(size);
+}
+
+static void *tracked_realloc(void *ptr, size_t old_size, size_t new_size) {
+  record_request(new_size, (long long) new_size - (long long) old_size, 1);
+  void *moved = stats.realloc(ptr, old_size, new_size);
+  if (moved != ptr) {
+    __atomic_fetch_add(&stats.bytes_copied, old_size < new_size ? old_size : new_size,
+                       __ATOMIC_RELAXED);
+  }
+  return moved;
+}
+
+static void tracked_free(void *ptr, size_t size) {
+  __atomic_fetch_add(&stats.frees, 1, __ATOMIC_RELAXED);
+  __atomic_sub_fetch(&stats.live_bytes, (unsigned long long) size, __ATOMIC_RELAXED);
+  stats.free(ptr, size);
+}
+
+void memory_track_allocations(void) {
+  if (stats.alloc == NULL) {
+    mp_get_memory_functions(&stats.alloc, &stats.realloc, &stats.free);
+    mp_set_memory_functions(tracked_alloc, tracked_realloc, tracked_free);
+  }
+}
+
+void memory_set_phase(AllocPhase phase) {
+  if (stats.alloc != NULL) {
+    // Each phase's peak starts from what the earlier phases left live
+    raise_to(&stats.phases[phase].peak_live_bytes,
+             __atomic_load_n(&stats.live_bytes, __ATOMIC_RELAXED));
+    __atomic_store_n(&stats.phase, (int) phase, __ATOMIC_RELAXED);
+  }
+}
+
+int memory_report_allocations(FILE *output, int json) {
+  if (stats.alloc == NULL) {
+    return 0;
+  }
+
+  int last = 0;
+  for (int i = 0; i < ALLOC_SIZE_BUCKETS; i++) {
+    if (stats.size_buckets[i] > 0) {
+      last = i;
+    }
+  }
+
+  int status = 0;
+  if (json) {
+    status |= fprintf(output,
+                      "{\"allocations\": %llu, \"reallocations\": %llu, \"frees\": %llu, "
+                      "\"bytes_allocated\": %llu, \"realloc_bytes_copied\": %llu, "
+                      "\"peak_live_bytes\": %llu, \"size_histogram\": [",
+                      stats.allocations, stats.reallocations, stats.frees,
+                      stats.bytes_allocated, stats.bytes_copied, stats.peak_live_bytes) < 0;
+    for (int i = 0; i <= last; i++) {
+      status |= fprintf(output, "%s{\"max_bytes\": %llu, \"count\": %llu}", i > 0 ? ", " : "",
+                        1ULL << i, stats.size_buckets[i]) < 0;
+    }
+    status |= fprintf(output, "], \"phases\": {") < 0;
+    for (int i = 0; i < ALLOC_PHASES; i++) {
+      const PhaseStats *phase = &stats.phases[i];
+      status |= fprintf(output,
+                        "%s\"%s\": {\"allocations\": %llu, \"reallocations\": %llu, "
+                        "\"bytes_allocated\": %llu, \"peak_live_bytes\": %llu}",
+                        i > 0 ? ", " : "", phase_names[i], phase->allocations,
+                        phase->reallocations, phase->bytes_allocated,
+                        phase->peak_live_bytes) < 0;
+    }
+    status |= fprintf(output, "}}\n") < 0;
+    return status ? -1 : 0;
+  }
+
+  status |= fprintf(output,
+                    "Allocation Statistics:\n"
+                    "  Allocations: %llu (%llu bytes)\n"
+                    "  Reallocations: %llu (%llu bytes copied)\n"
+                    "  Frees: %llu\n"
+                    "  Peak live: %llu bytes\n"
+                    "  Size histogram:\n",
+                    stats.allocations, stats.bytes_allocated, stats.reallocations,
+                    stats.bytes_copied, stats.frees, stats.peak_live_bytes) < 0;
+  for (int i = 0; i <= last; i++) {
+    if (stats.size_buckets[i] > 0) {
+      status |= fprintf(output, "    <= %llu bytes: %llu\n", 1ULL << i, stats.size_buckets[i]) < 0;
+    }
+  }
+  for (int i = 0; i < ALLOC_PHASES; i++) {
+    const PhaseStats *phase = &stats.phases[i];
+    status |= fprintf(output,
+                      "  Phase %s: %llu allocations, %llu reallocations, %llu bytes, "
+                      "peak live %llu bytes\n",
+                      phase_names[i], phase->allocations, phase->reallocations,
+                      phase->bytes_allocated, phase->peak_live_bytes) < 0;
+  }
+  return status ? -1 : 0;
+}
+
+/**
+ * Bytes held by an engine at its peak, in units of the size of F(n), as measured with
+ * getrusage on 64-bit Linux. matrix_power keeps two matrices and the temporaries of each
+ * level alive; fast doubling in place keeps three values; the additive loops keep three
+ * values but never multiply. Both figures include GMP's multiplication scratch.
+ */
+static double engine_peak_factor(Algorithm algo, int low_memory) {
+  if (low_memory) {
+    return 7.0;
+  }
+  return algo == MATRIX ? 11.0 : 4.0;
+}
+
+/**
+ * Bytes needed on top of F(n) to write its digits. mpz_get_str builds the whole string (one
+ * byte per digit) plus its conversion scratch. Streaming reads hex and binary digits straight
+ * from the limbs, while decimal streaming pays for the divide-and-conquer quotients instead
+ * of the string.
+ */
+static double format_peak_factor(OutputFormat format, int streamed) {
+  switch (format) {
+    case HEXADECIMAL:
+      return streamed ? 0.1 : 2.1;
+    case BINARY:
+      return streamed ? 0.1 : 9.1;
+    default:
+      return 7.5;
+  }
+}
+
+size_t memory_peak_resident(void) {
+  struct rusage usage;
+  if (getrusage(RUSAGE_SELF, &usage) != 0) {
+    return 0;
+  }
+#ifdef __APPLE__
+  return (size_t) usage.ru_maxrss;  // bytes on macOS
+#else
+  return (size_t) usage.ru_maxrss * 1024;  // kilobytes elsewhere
+#endif
+}
+
+size_t memory_predict_peak(long n, Algorithm algo, OutputFormat format, int write_digits,
+                           int low_memory) {
+  // F(n) has about n log2(phi) bits
+  double value_bytes = (double) n * 0.69424191363 / 8.0 + 64.0;
+  double peak = engine_peak_factor(algo, low_memory);
+  if (write_digits) {
+    double writing = 1.0 + format_peak_factor(format, low_memory);
+    if (writing > peak) {
+      peak = writing;
+    }
+  }
+  return memory_peak_resident() + (size_t) (peak * value_bytes);
+}
@@ -0,0 +1,46 @@
+#ifndef PROBES_H
+#define PROBES_H
+
+// USDT static probes for bpftrace and perf, built in with `make USDT=1` (needs sys/sdt.h, e.g.
+// from systemtap-sdt-dev). Each probe is a nop in the text plus a note in .note.stapsdt, so
+// an idle probe costs nothing; without USDT every probe expands to nothing at all.
+// The probes and their arguments are listed in the README.
+//
+// Arguments are still evaluated when nobody is attached, so a probe whose arguments cost
+// anything (strlen over the digits) goes inside if (FIB_PROBE_ENABLED(name)). The tracer
+// raises the probe's semaphore while it is attached, as with dtrace -h generated headers.
+#define FIB_PROBES(X)                                                                         \
+  X(calc__start)                                                                              \
+  X(calc__done)                                                                               \
+  X(matrix__multiply__start)                                                                  \
+  X(matrix__multiply__done)                                                                   \
+  X(format__start)                                                                            \
+  X(format__done)                                                                             \
+  X(output__write)                                                                            \
+  X(history__load__start)                                                                     \
+  X(history__load__done)                                                                      \
+  X(history__save__start)                                                                     \
+  X(history__save__done)
+
+#ifdef FIB_USDT
+#define _SDT_HAS_SEMAPHORES 1
+#include <sys/sdt.h>
+// Semaphores are defined once, in utils.c
+#define FIB_PROBE_SEMAPHORE(name) \
+  unsigned short fib_##name##_semaphore __attribute__((unused, section(".probes")));
+#define FIB_PROBE_DECLARE(name) extern FIB_PROBE_SEMAPHORE(name)
+FIB_PROBES(FIB_PROBE_DECLARE)
+#define FIB_PROBE_ENABLED(name) __builtin_expect(fib_##name##_semaphore, 0)
+#define FIB_PROBE0(name) DTRACE_PROBE(fib, name)
+#define FIB_PROBE1(name, a) DTRACE_PROBE1(fib, name, a)
+#define FIB_PROBE2(name, a, b) DTRACE_PROBE2(fib, name, a, b)
+#define FIB_PROBE3(name, a, b, c) DTRACE_PROBE3(fib, name, a, b, c)
+#else
+#define FIB_PROBE_ENABLED(name) 0
+#define FIB_PROBE0(name) ((void) 0)
+#define FIB_PROBE1(name, a) ((void) 0)
+#define FIB_PROBE2(name, a, b) ((void) 0)
+#define FIB_PROBE3(name, a, b, c) ((void) 0)
+#endif
+
+#endif
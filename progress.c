@@ -0,0 +1,219 @@
+#include "fib.h"
+#include <math.h>
+#include <pthread.h>
+#include <signal.h>
+#include <stdio.h>
+#include <time.h>
+
+// Seconds between verbose updates, and how often the reporter looks for a SIGUSR1 request
+#define PROGRESS_UPDATE_SECONDS 1.0
+#define PROGRESS_POLL_NANOSECONDS 100000000L
+
+// Cost of a doubling level relative to the one before it
+#define PROGRESS_LEVEL_GROWTH 2.2
+
+long progress_done;
+int calculation_cancelled;
+
+// The task being tracked; written by the computing thread before it sets active
+static struct {
+  const char *task;
+  const char *unit;
+  long total;
+  ProgressModel model;
+  double start;
+  int active;
+} current;
+
+static struct {
+  pthread_t thread;
+  pthread_mutex_t lock;
+  pthread_cond_t wake;  // cuts the poll short when the reporter is stopped
+  int running;
+  int stop;  // guarded by lock
+  int verbose;
+  double deadline;  // monotonic time at which to cancel, or 0; guarded by lock
+} reporter = {.lock = PTHREAD_MUTEX_INITIALIZER, .wake = PTHREAD_COND_INITIALIZER};
+
+// Phase of the run, so a dump between engine tasks (conversion, output) still says something
+static struct {
+  pthread_mutex_t lock;
+  const char *name;
+  double start;
+} phase = {.lock = PTHREAD_MUTEX_INITIALIZER};
+
+static volatile sig_atomic_t dump_requested;
+
+static void request_dump(int signo) {
+  (void) signo;
+  dump_requested = 1;
+}
+
+void progress_begin(const char *task, const char *unit, long total, ProgressModel model) {
+  __atomic_store_n(&current.active, 0, __ATOMIC_RELEASE);
+  current.task = task;
+  current.unit = unit;
+  current.total = total > 0 ? total : 1;
+  current.model = model;
+  current.start = monotonic_seconds();
+  __atomic_store_n(&progress_done, 0, __ATOMIC_RELAXED);
+  __atomic_store_n(&current.active, 1, __ATOMIC_RELEASE);
+}
+
+void progress_end(void) {
+  // A cancelled task stays on record so the caller can report how far it got
+  if (!CALCULATION_CANCELLED()) {
+    __atomic_store_n(&current.active, 0, __ATOMIC_RELEASE);
+  }
+}
+
+void progress_phase(const char *name) {
+  pthread_mutex_lock(&phase.lock);
+  phase.name = name;
+  phase.start = monotonic_seconds();
+  pthread_mutex_unlock(&phase.lock);
+}
+
+void calculation_cancel(void) {
+  __atomic_store_n(&calculation_cancelled, 1, __ATOMIC_RELAXED);
+}
+
+void calculation_reset(void) {
+  __atomic_store_n(&calculation_cancelled, 0, __ATOMIC_RELAXED);
+  __atomic_store_n(&current.active, 0, __ATOMIC_RELEASE);
+}
+
+/**
+ * Share of the total work done after `done` of `total` units under the engine's cost model.
+ */
+static double work_fraction(long done, long total, ProgressModel model) {
+  double share = (double) done / (double) total;
+  switch (model) {
+    case PROGRESS_QUADRATIC:
+      // Step i adds numbers of about i digits, so the first i steps cost about i^2 / 2
+      return share * share;
+    case PROGRESS_DOUBLING:
+      // Operands double at every level and GMP multiplies a little worse than linearly, so
+      // each level costs somewhat more than all the levels before it together
+      return (pow(PROGRESS_LEVEL_GROWTH, (double) done) - 1.0) /
+             (pow(PROGRESS_LEVEL_GROWTH, (double) total) - 1.0);
+    case PROGRESS_LINEAR:
+    default:
+      return share;
+  }
+}
+
+int progress_report(FILE *output) {
+  if (!__atomic_load_n(&current.active, __ATOMIC_ACQUIRE)) {
+    pthread_mutex_lock(&phase.lock);
+    const char *name = phase.name;
+    double elapsed = monotonic_seconds() - phase.start;
+    pthread_mutex_unlock(&phase.lock);
+    if (name != NULL) {
+      return fprintf(output, "Progress: no calculation running; %s phase, %.1f s elapsed\n", name,
+                     elapsed) < 0
+                 ? -1
+                 : 0;
+    }
+    return fprintf(output, "Progress: no calculation running\n") < 0 ? -1 : 0;
+  }
+  long done = __atomic_load_n(&progress_done, __ATOMIC_RELAXED);
+  if (done > current.total) {
+    done = current.total;
+  }
+  double elapsed = monotonic_seconds() - current.start;
+  double fraction = work_fraction(done, current.total, current.model);
+  double rate = elapsed > 0.0 ? (double) done / elapsed : 0.0;
+  int status = fprintf(output, "Progress: %s: %ld of %ld %s (%.1f%% of the work), %.0f %s/s, ",
+                       current.task, done, current.total, current.unit, fraction * 100.0, rate,
+                       current.unit) < 0;
+  if (fraction > 0.0) {
+    status |= fprintf(output, "%.1f s elapsed, ETA %.1f s\n", elapsed,
+                      elapsed * (1.0 - fraction) / fraction) < 0;
+  } else {
+    status |= fprintf(output, "%.1f s elapsed, ETA unknown\n", elapsed) < 0;
+  }
+  return status ? -1 : 0;
+}
+
+static void *report_progress(void *arg) {
+  (void) arg;
+  double last_update = monotonic_seconds();
+  pthread_mutex_lock(&reporter.lock);
+  while (!reporter.stop) {
+    // The handler cannot signal a condition variable, so SIGUSR1 is picked up by polling
+    struct timespec deadline;
+    clock_gettime(CLOCK_REALTIME, &deadline);
+    deadline.tv_nsec += PROGRESS_POLL_NANOSECONDS;
+    if (deadline.tv_nsec >= 1000000000L) {
+      deadline.tv_sec++;
+      deadline.tv_nsec -= 1000000000L;
+    }
+    pthread_cond_timedwait(&reporter.wake, &reporter.lock, &deadline);
+    if (reporter.stop) {
+      break;
+    }
+    double cancel_at = reporter.deadline;
+    pthread_mutex_unlock(&reporter.lock);
+
+    if (dump_requested) {
+      dump_requested = 0;
+      progress_report(stderr);
+    }
+    double now = monotonic_seconds();
+    if (cancel_at > 0.0 && now >= cancel_at) {
+      calculation_cancel();
+    }
+    if (reporter.verbose && now - last_update >= PROGRESS_UPDATE_SECONDS &&
+        __atomic_load_n(&current.active, __ATOMIC_ACQUIRE)) {
+      progress_report(stderr);
+      last_update = now;
+    }
+    pthread_mutex_lock(&reporter.lock);
+  }
+  pthread_mutex_unlock(&reporter.lock);
+  return NULL;
+}
+
+void progress_install_handler(void) {
+  // A request that arrives before the reporter starts waits for it instead of killing the
+  // process, which is the default action of SIGUSR1
+  struct sigaction action;
+  action.sa_handler = request_dump;
+  sigemptyset(&action.sa_mask);
+  action.sa_flags = SA_RESTART;
+  sigaction(SIGUSR1, &action, NULL);
+}
+
+int progress_start_reporter(int verbose, double deadline) {
+  pthread_mutex_lock(&reporter.lock);
+  reporter.stop = 0;
+  reporter.deadline = deadline;
+  pthread_mutex_unlock(&reporter.lock);
+  reporter.verbose = verbose;
+  reporter.running = pthread_create(&reporter.thread, NULL, report_progress, NULL) == 0;
+  return reporter.running ? 0 : -1;
+}
+
+void progress_set_deadline(double deadline) {
+  pthread_mutex_lock(&reporter.lock);
+  reporter.deadline = deadline;
+  pthread_mutex_unlock(&reporter.lock);
+}
+
+void progress_stop_reporter(void) {
+  if (!reporter.running) {
+    return;
+  }
+  pthread_mutex_lock(&reporter.lock);
+  reporter.stop = 1;
+  pthread_cond_signal(&reporter.wake);
+  pthread_mutex_unlock(&reporter.lock);
+  pthread_join(reporter.thread, NULL);
+  reporter.running = 0;
+  // Answer a request that came in after the last poll
+  if (dump_requested) {
+    dump_requested = 0;
+    progress_report(stderr);
+  }
+}
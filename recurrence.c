@@ -0,0 +1,433 @@
+#include "fib.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+// Recurrences accepted from the command line are capped well below what fits in memory anyway
+#define RECURRENCE_MAX_ORDER 65536
+
+typedef struct {
+  const char *name;
+  const char *label;
+  const char *spec;
+} RecurrencePreset;
+
+static const RecurrencePreset presets[] = {
+    {"fibonacci", "Fibonacci Number", "1,1;0,1"},
+    {"lucas", "Lucas Number", "1,1;2,1"},
+    {"pell", "Pell Number", "2,1;0,1"},
+    {"pell-lucas", "Pell-Lucas Number", "2,1;2,2"},
+    {"jacobsthal", "Jacobsthal Number", "1,2;0,1"},
+    {"padovan", "Padovan Number", "0,1,1;1,1,1"},
+    {"tribonacci", "Tribonacci Number", "1,1,1;0,0,1"},
+    {"tetranacci", "Tetranacci Number", "1,1,1,1;0,0,0,1"},
+};
+
+/**
+ * Polynomial arithmetic modulo the characteristic polynomial
+ * P(x) = x^k - c1 x^(k-1) - ... - ck. Polynomials are arrays of coefficients, lowest first.
+ */
+typedef struct {
+  long order;
+  mpz_t *tail;      // x^k mod P, i.e. tail[i] = c(k - i)
+  mpz_t *inverse;   // 1 / rev(P) mod x^(k - 1), for quotient estimation
+  mpz_t *product;   // 2k - 1 coefficients of scratch
+  mpz_t *high;      // k coefficients of scratch
+  mpz_t *quotient;  // k coefficients of scratch
+  mpz_t *scratch;   // k coefficients of scratch
+  mpz_t packed_a;
+  mpz_t packed_b;
+} KitamasaContext;
+
+static mpz_t *poly_alloc(long len) {
+  mpz_t *poly = malloc(sizeof(mpz_t) * (size_t) len);
+  if (poly != NULL) {
+    for (long i = 0; i < len; i++) {
+      mpz_init(poly[i]);
+    }
+  }
+  return poly;
+}
+
+static void poly_free(mpz_t *poly, long len) {
+  if (poly != NULL) {
+    for (long i = 0; i < len; i++) {
+      mpz_clear(poly[i]);
+    }
+    free(poly);
+  }
+}
+
+static size_t poly_max_bits(mpz_t *poly, long len) {
+  size_t bits = 0;
+  for (long i = 0; i < len; i++) {
+    size_t size = mpz_sizeinbase(poly[i], 2);
+    if (size > bits) {
+      bits = size;
+    }
+  }
+  return bits;
+}
+
+/**
+ * Sets low to value mod 2^bits as a balanced residue in [-2^(bits - 1), 2^(bits - 1)).
+ */
+static void balanced_residue(mpz_t low, const mpz_t value, mp_bitcnt_t bits) {
+  mpz_fdiv_r_2exp(low, value, bits);
+  if (mpz_tstbit(low, bits - 1)) {
+    mpz_cdiv_r_2exp(low, value, bits);
+  }
+}
+
+/**
+ * Kronecker substitution: evaluates the polynomial at x = 2^slot. Signed coefficients are fine
+ * since the halves are combined with exact big-integer additions.
+ */
+static void kronecker_pack(mpz_t out, mpz_t *poly, long len, mp_bitcnt_t slot) {
+  if (len == 1) {
+    mpz_set(out, poly[0]);
+    return;
+  }
+
+  long half = len / 2;
+  mpz_t high;
+  mpz_init(high);
+  kronecker_pack(high, poly + half, len - half, slot);
+  kronecker_pack(out, poly, half, slot);
+  mpz_mul_2exp(high, high, slot * (mp_bitcnt_t) half);
+  mpz_add(out, out, high);
+  mpz_clear(high);
+}
+
+/**
+ * Inverse of kronecker_pack for coefficients with |c| < 2^(slot - 1). Each split takes the low
+ * half as a balanced residue, so borrows from negative coefficients resolve in O(log len) levels
+ * instead of one pass per coefficient. Consumes value.
+ */
+static void kronecker_unpack(mpz_t *poly, long len, mpz_t value, mp_bitcnt_t slot) {
+  if (len == 1) {
+    mpz_swap(poly[0], value);
+    return;
+  }
+
+  long half = len / 2;
+  mp_bitcnt_t bits = slot * (mp_bitcnt_t) half;
+  mpz_t low;
+  mpz_init(low);
+  balanced_residue(low, value, bits);
+  mpz_sub(value, value, low);
+  mpz_fdiv_q_2exp(value, value, bits);
+
+  kronecker_unpack(poly, half, low, slot);
+  kronecker_unpack(poly + half, len - half, value, slot);
+  mpz_clear(low);
+}
+
+/**
+ * Sets out to the first out_len coefficients of a * b with a single big-integer multiplication.
+ * out must not overlap a or b.
+ */
+static void poly_mul(KitamasaContext *ctx, mpz_t *out, long out_len, mpz_t *a, long a_len,
+                     mpz_t *b, long b_len) {
+  long full = a_len + b_len - 1;
+  long len = out_len < full ? out_len : full;
+  long shorter = a_len < b_len ? a_len : b_len;
+
+  // |coefficient| <= shorter * 2^(bits(a) + bits(b)), plus a sign bit
+  mp_bitcnt_t slot = (mp_bitcnt_t) (poly_max_bits(a, a_len) + poly_max_bits(b, b_len)) + 2;
+  for (long n = shorter; n > 0; n >>= 1) {
+    slot++;
+  }
+
+  kronecker_pack(ctx->packed_a, a, a_len, slot);
+  if (a == b && a_len == b_len) {
+    mpz_mul(ctx->packed_a, ctx->packed_a, ctx->packed_a);
+  } else {
+    kronecker_pack(ctx->packed_b, b, b_len, slot);
+    mpz_mul(ctx->packed_a, ctx->packed_a, ctx->packed_b);
+  }
+
+  // Truncating to len coefficients keeps the balanced residue mod 2^(slot * len)
+  if (len < full) {
+    balanced_residue(ctx->packed_b, ctx->packed_a, slot * (mp_bitcnt_t) len);
+    mpz_swap(ctx->packed_a, ctx->packed_b);
+  }
+
+  kronecker_unpack(out, len, ctx->packed_a, slot);
+  for (long i = len; i < out_len; i++) {
+    mpz_set_ui(out[i], 0);
+  }
+}
+
+/**
+ * Sets out (k coefficients) to poly mod P for poly of length len <= 2k - 1.
+ *
+ * The quotient comes from the reversed top coefficients times 1 / rev(P), and since
+ * P = x^k - tail, the remainder is low(poly) + low(quotient * tail): two multiplications
+ * instead of len - k long-division steps.
+ */
+static void poly_reduce(KitamasaContext *ctx, mpz_t *out, mpz_t *poly, long len) {
+  long k = ctx->order;
+  if (len <= k) {
+    for (long i = 0; i < k; i++) {
+      if (i < len) {
+        mpz_set(out[i], poly[i]);
+      } else {
+        mpz_set_ui(out[i], 0);
+      }
+    }
+    return;
+  }
+
+  long excess = len - k;
+  for (long i = 0; i < excess; i++) {
+    mpz_set(ctx->high[i], poly[len - 1 - i]);
+  }
+  poly_mul(ctx, ctx->scratch, excess, ctx->high, excess, ctx->inverse, excess);
+  for (long i = 0; i < excess; i++) {
+    mpz_swap(ctx->quotient[i], ctx->scratch[excess - 1 - i]);
+  }
+
+  poly_mul(ctx, ctx->scratch, k, ctx->quotient, excess, ctx->tail, k);
+  for (long i = 0; i < k; i++) {
+    mpz_add(out[i], poly[i], ctx->scratch[i]);
+  }
+}
+
+/**
+ * Computes 1 / rev(P) mod x^(k - 1) by Newton iteration: I <- I (2 - rev(P) I).
+ */
+static void compute_inverse(KitamasaContext *ctx, const Recurrence *rec) {
+  long k = ctx->order;
+  long target = k - 1;
+
+  // rev(P) = 1 - c1 x - ... - ck x^k, kept in product (only the first k - 1 terms matter)
+  mpz_t *reversed = ctx->product;
+  mpz_set_ui(reversed[0], 1);
+  for (long i = 1; i < target; i++) {
+    mpz_neg(reversed[i], rec->coefficients[i - 1]);
+  }
+
+  mpz_set_ui(ctx->inverse[0], 1);
+  for (long done = 1; done < target;) {
+    long next = done * 2 < target ? done * 2 : target;
+    poly_mul(ctx, ctx->high, next, reversed, next, ctx->inverse, done);
+    for (long i = 0; i < next; i++) {
+      mpz_neg(ctx->high[i], ctx->high[i]);
+    }
+    mpz_add_ui(ctx->high[0], ctx->high[0], 2);
+    poly_mul(ctx, ctx->scratch, next, ctx->inverse, done, ctx->high, next);
+    for (long i = 0; i < next; i++) {
+      mpz_swap(ctx->inverse[i], ctx->scratch[i]);
+    }
+    done = next;
+  }
+}
+
+static void kitamasa_clear(KitamasaContext *ctx) {
+  long k = ctx->order;
+  poly_free(ctx->tail, k);
+  poly_free(ctx->inverse, k);
+  poly_free(ctx->product, 2 * k - 1);
+  poly_free(ctx->high, k);
+  poly_free(ctx->quotient, k);
+  poly_free(ctx->scratch, k);
+  mpz_clear(ctx->packed_a);
+  mpz_clear(ctx->packed_b);
+}
+
+static int kitamasa_init(KitamasaContext *ctx, const Recurrence *rec) {
+  long k = rec->order;
+  ctx->order = k;
+  ctx->tail = poly_alloc(k);
+  ctx->inverse = poly_alloc(k);
+  ctx->product = poly_alloc(2 * k - 1);
+  ctx->high = poly_alloc(k);
+  ctx->quotient = poly_alloc(k);
+  ctx->scratch = poly_alloc(k);
+  mpz_init(ctx->packed_a);
+  mpz_init(ctx->packed_b);
+
+  if (ctx->tail == NULL || ctx->inverse == NULL || ctx->product == NULL || ctx->high == NULL ||
+      ctx->quotient == NULL || ctx->scratch == NULL) {
+    kitamasa_clear(ctx);
+    return -1;
+  }
+
+  for (long i = 0; i < k; i++) {
+    mpz_set(ctx->tail[i], rec->coefficients[k - 1 - i]);
+  }
+  compute_inverse(ctx, rec);
+  return 0;
+}
+
+int calculate_recurrence(mpz_t result, const Recurrence *rec, long n, int verbose) {
+  long k = rec->order;
+  if (n < 0 || k < 1) {
+    return -1;
+  }
+
+  if (n < k) {
+    mpz_set(result, rec->seeds[n]);
+    return 0;
+  }
+
+  // a(n) = c1^n a(0) for first-order recurrences
+  if (k == 1) {
+    if (verbose) {
+      fprintf(stderr, "Using direct power for a first-order recurrence\n");
+    }
+    mpz_pow_ui(result, rec->coefficients[0], (unsigned long) n);
+    mpz_mul(result, result, rec->seeds[0]);
+    return 0;
+  }
+
+  if (verbose) {
+    fprintf(stderr, "Using Kitamasa polynomial exponentiation for order-%ld recurrence\n", k);
+  }
+
+  KitamasaContext ctx;
+  if (kitamasa_init(&ctx, rec) != 0) {
+    return -1;
+  }
+
+  mpz_t *power = poly_alloc(k);
+  if (power == NULL) {
+    kitamasa_clear(&ctx);
+    return -1;
+  }
+
+  // x^n mod P by left-to-right binary exponentiation, starting from x^1
+  int bit = (int) sizeof(long) * 8 - 2;
+  while (((n >> bit) & 1) == 0) {
+    bit--;
+  }
+  mpz_set_ui(power[1], 1);
+
+  // One squaring per bit below the top one; a cancelled run leaves power unfinished
+  progress_begin("recurrence", "squarings", bit, PROGRESS_DOUBLING);
+  for (bit--; bit >= 0 && !CALCULATION_CANCELLED(); bit--) {
+    poly_mul(&ctx, ctx.product, 2 * k - 1, power, k, power, k);
+    poly_reduce(&ctx, power, ctx.product, 2 * k - 1);
+
+    if ((n >> bit) & 1) {
+      // Multiply by x: shift up and fold the x^k coefficient back through the tail
+      mpz_swap(ctx.packed_b, power[k - 1]);
+      for (long i = k - 1; i > 0; i--) {
+        mpz_swap(power[i], power[i - 1]);
+      }
+      mpz_set_ui(power[0], 0);
+      for (long i = 0; i < k; i++) {
+        mpz_addmul(power[i], ctx.packed_b, ctx.tail[i]);
+      }
+    }
+    PROGRESS_ADVANCE();
+  }
+  progress_end();
+
+  // x^n = sum r_i x^i mod P gives a(n) = sum r_i a(i)
+  mpz_set_ui(result, 0);
+  for (long i = 0; i < k; i++) {
+    mpz_addmul(result, power[i], rec->seeds[i]);
+  }
+
+  poly_free(power, k);
+  kitamasa_clear(&ctx);
+  return 0;
+}
+
+/**
+ * Parses a comma-separated list of decimal integers into a newly allocated array.
+ *
+ * @return number of values, or -1 on a malformed list
+ */
+static long parse_integer_list(mpz_t **values, char *text) {
+  long count = 1;
+  for (const char *p = text; *p; p++) {
+    if (*p == ',') {
+      count++;
+    }
+  }
+  if (count > RECURRENCE_MAX_ORDER) {
+    return -1;
+  }
+
+  *values = poly_alloc(count);
+  if (*values == NULL) {
+    return -1;
+  }
+
+  char *token = text;
+  for (long i = 0; i < count; i++) {
+    char *comma = strchr(token, ',');
+    if (comma != NULL) {
+      *comma = '\0';
+    }
+    token += strspn(token, " \t");
+    if (*token == '\0' || mpz_set_str((*values)[i], token, 10) != 0) {
+      poly_free(*values, count);
+      *values = NULL;
+      return -1;
+    }
+    if (comma != NULL) {
+      token = comma + 1;
+    }
+  }
+  return count;
+}
+
+int recurrence_parse(Recurrence *rec, const char *spec) {
+  rec->label = "Recurrence Term";
+  rec->order = 0;
+  rec->coefficients = NULL;
+  rec->seeds = NULL;
+
+  for (size_t i = 0; i < sizeof(presets) / sizeof(presets[0]); i++) {
+    if (strcmp(spec, presets[i].name) == 0) {
+      int status = recurrence_parse(rec, presets[i].spec);
+      rec->label = presets[i].label;
+      return status;
+    }
+  }
+
+  size_t len = strlen(spec);
+  char *text = malloc(len + 1);
+  if (text == NULL) {
+    return -1;
+  }
+  memcpy(text, spec, len + 1);
+
+  char *separator = strchr(text, ';');
+  if (separator == NULL) {
+    free(text);
+    return -1;
+  }
+  *separator = '\0';
+
+  long order = parse_integer_list(&rec->coefficients, text);
+  long seed_count = order > 0 ? parse_integer_list(&rec->seeds, separator + 1) : -1;
+  free(text);
+
+  if (order < 0 || seed_count != order) {
+    if (order > 0) {
+      poly_free(rec->coefficients, order);
+    }
+    if (seed_count > 0) {
+      poly_free(rec->seeds, seed_count);
+    }
+    rec->coefficients = NULL;
+    rec->seeds = NULL;
+    return -1;
+  }
+
+  rec->order = order;
+  return 0;
+}
+
+void recurrence_clear(Recurrence *rec) {
+  poly_free(rec->coefficients, rec->order);
+  poly_free(rec->seeds, rec->order);
+  rec->coefficients = NULL;
+  rec->seeds = NULL;
+  rec->order = 0;
+}
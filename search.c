@@ -0,0 +1,420 @@
+#include "fib.h"
+#include <fcntl.h>
+#include <limits.h>
+#include <pthread.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
+
+// Trial divisors q = 2kp +- 1 tried per candidate index p before the full primality test
+#define SEARCH_SIEVE_MULTIPLIERS 4096
+#define SEARCH_PRIME_REPS 25
+
+// How often the calling thread looks for a cancellation while the workers run
+#define SEARCH_POLL_NANOSECONDS 100000000L
+#define SEARCH_STATE_MAGIC "fib-prime-search 1"
+
+#ifndef O_NOFOLLOW
+#define O_NOFOLLOW 0
+#endif
+
+typedef enum { CANDIDATE_PENDING, CANDIDATE_COMPOSITE, CANDIDATE_PRIME } CandidateState;
+
+typedef struct {
+  long index;
+  CandidateState state;
+} Candidate;
+
+// Shared by the workers and the calling thread, which stops waiting for workers stuck in a
+// primality test once the search is cancelled; the last of them to let go frees it
+typedef struct {
+  Candidate *candidates;
+  size_t count;
+  size_t next;  // next pending candidate to hand out, guarded by lock
+  size_t finished;
+  FILE *state_file;
+  int verbose;
+  int abandoned;   // the caller has returned; results are no longer recorded
+  int references;  // caller plus running workers, guarded by lock
+  pthread_mutex_t lock;
+  pthread_cond_t idle;  // signalled as each worker lets go
+} SearchQueue;
+
+static int is_small_prime(long n) {
+  if (n < 2) {
+    return 0;
+  }
+  for (long d = 2; d * d <= n; d++) {
+    if (n % d == 0) {
+      return 0;
+    }
+  }
+  return 1;
+}
+
+/**
+ * F(n) mod q by fast doubling in machine words; q < 2^32 keeps every product in 64 bits.
+ */
+static uint64_t fibonacci_mod_word(long n, uint64_t q) {
+  uint64_t a = 0;  // F(k)
+  uint64_t b = 1;  // F(k + 1)
+  for (int bit = (int) sizeof(long) * 8 - 2; bit >= 0; bit--) {
+    uint64_t even = a * ((2 * b + q - a) % q) % q;
+    uint64_t odd = (a * a % q + b * b % q) % q;
+    if ((n >> bit) & 1) {
+      a = odd;
+      b = (even + odd) % q;
+    } else {
+      a = even;
+      b = odd;
+    }
+  }
+  return a % q;
+}
+
+/**
+ * Looks for a small factor of F(p) for prime p >= 5. Any prime factor q of F(p) has rank of
+ * apparition p, so p divides q - (5/q) and q = 2kp +- 1; only those are worth trying.
+ */
+static int has_small_factor(long p) {
+  // Below this F(p) < 2^32 could itself be one of the trial divisors
+  if (p < 50) {
+    return 0;
+  }
+  for (uint64_t k = 1; k <= SEARCH_SIEVE_MULTIPLIERS; k++) {
+    uint64_t base = 2 * k * (uint64_t) p;
+    if (base + 1 >= ((uint64_t) 1 << 32)) {
+      break;
+    }
+    for (int sign = -1; sign <= 1; sign += 2) {
+      uint64_t q = base + (uint64_t) (int64_t) sign;
+      // Cheap wheel: other multiples of 3 and 5 cannot be the smallest prime factor
+      if (q % 3 == 0 || q % 5 == 0) {
+        continue;
+      }
+      if (fibonacci_mod_word(p, q) == 0) {
+        return 1;
+      }
+    }
+  }
+  return 0;
+}
+
+/**
+ * Reads the indices already decided by an earlier run over the same range.
+ *
+ * @return 0 if the state matches the range (or does not exist yet or is empty), -1 otherwise
+ */
+static int load_search_state(const char *path, long a, long b, Candidate *candidates,
+                             size_t count) {
+  FILE *file = fopen(path, "r");
+  if (file == NULL) {
+    return 0;
+  }
+
+  // An empty file is one created ahead of the run or left by a run that died before writing
+  // the header; it gets the header like a new one
+  char line[128];
+  long state_a, state_b;
+  if (fgets(line, sizeof(line), file) == NULL) {
+    fclose(file);
+    return 0;
+  }
+  if (sscanf(line, SEARCH_STATE_MAGIC " %ld %ld", &state_a, &state_b) != 2 || state_a != a ||
+      state_b != b) {
+    fclose(file);
+    return -1;
+  }
+
+  // Candidates are sorted by index, so each recorded result is a binary search away
+  while (fgets(line, sizeof(line), file) != NULL) {
+    long index;
+    char verdict[16];
+    if (sscanf(line, "%ld %15s", &index, verdict) != 2) {
+      continue;
+    }
+    size_t lo = 0, hi = count;
+    while (lo < hi) {
+      size_t mid = lo + (hi - lo) / 2;
+      if (candidates[mid].index < index) {
+        lo = mid + 1;
+      } else {
+        hi = mid;
+      }
+    }
+    if (lo < count && candidates[lo].index == index) {
+      if (strcmp(verdict, "prime") == 0) {
+        candidates[lo].state = CANDIDATE_PRIME;
+      } else if (strcmp(verdict, "composite") == 0) {
+        candidates[lo].state = CANDIDATE_COMPOSITE;
+      }
+    }
+  }
+
+  fclose(file);
+  return 0;
+}
+
+static void queue_release(SearchQueue *queue) {
+  pthread_mutex_lock(&queue->lock);
+  int last = --queue->references == 0;
+  pthread_cond_signal(&queue->idle);
+  pthread_mutex_unlock(&queue->lock);
+  if (last) {
+    pthread_mutex_destroy(&queue->lock);
+    pthread_cond_destroy(&queue->idle);
+    free(queue->candidates);
+    free(queue);
+  }
+}
+
+static void record_result(SearchQueue *queue, Candidate *candidate, CandidateState state) {
+  pthread_mutex_lock(&queue->lock);
+  if (queue->abandoned) {
+    // Left pending, so a search state picks it up again
+    pthread_mutex_unlock(&queue->lock);
+    return;
+  }
+  candidate->state = state;
+  queue->finished++;
+  if (queue->state_file != NULL) {
+    fprintf(queue->state_file, "%ld %s\n", candidate->index,
+            state == CANDIDATE_PRIME ? "prime" : "composite");
+    fflush(queue->state_file);
+  }
+  if (queue->verbose) {
+    fprintf(stderr, "F(%ld) is %s (%zu of %zu done)\n", candidate->index,
+            state == CANDIDATE_PRIME ? "a probable prime" : "composite", queue->finished,
+            queue->count);
+  }
+  pthread_mutex_unlock(&queue->lock);
+}
+
+/**
+ * Worker loop: repeatedly claims the next pending candidate from the shared queue, so a thread
+ * that finishes early takes over work instead of idling behind a fixed partition.
+ */
+static void *search_worker(void *arg) {
+  SearchQueue *queue = arg;
+  mpz_t value, next_value;
+  mpz_init(value);
+  mpz_init(next_value);
+
+  while (!CALCULATION_CANCELLED()) {
+    Candidate *candidate = NULL;
+    pthread_mutex_lock(&queue->lock);
+    while (queue->next < queue->count && candidate == NULL) {
+      // Hand out the largest indices first so the longest tests do not finish last
+      Candidate *next = &queue->candidates[queue->count - 1 - queue->next];
+      queue->next++;
+      if (next->state == CANDIDATE_PENDING) {
+        candidate = next;
+      }
+    }
+    pthread_mutex_unlock(&queue->lock);
+    if (candidate == NULL) {
+      break;
+    }
+
+    long p = candidate->index;
+    CandidateState state;
+    if (has_small_factor(p)) {
+      state = CANDIDATE_COMPOSITE;
+    } else {
+      // The pair leaves the progress task alone, which calculate_fibonacci_matrix would take
+      // over from every worker at once
+      calculate_fibonacci_pair(value, next_value, p, 0);
+      if (CALCULATION_CANCELLED()) {
+        // Left pending, so a search state picks it up again
+        break;
+      }
+      // GMP's test cannot be interrupted; a cancelled search stops waiting for it instead
+      state = mpz_probab_prime_p(value, SEARCH_PRIME_REPS) > 0 ? CANDIDATE_PRIME
+                                                               : CANDIDATE_COMPOSITE;
+    }
+    record_result(queue, candidate, state);
+  }
+
+  mpz_clear(value);
+  mpz_clear(next_value);
+  queue_release(queue);
+  return NULL;
+}
+
+int fibonacci_prime_search(long a, long b, int threads, const char *state_path, FILE *output,
+                           int raw_output, int verbose) {
+  if (a < 0 || b < a) {
+    return -1;
+  }
+
+  // F(n) can only be prime for n = 4 or prime n (F(m) divides F(n) whenever m divides n)
+  size_t span = (size_t) (b - a) + 1;
+  unsigned char *composite = calloc(span, 1);
+  if (composite == NULL) {
+    return -1;
+  }
+  for (long d = 2; d <= b / d; d++) {
+    if (!is_small_prime(d)) {
+      continue;
+    }
+    long first = (a + d - 1) / d * d;
+    if (first < d * d) {
+      first = d * d;
+    }
+    for (long m = first; m <= b && m >= first; m += d) {
+      composite[m - a] = 1;
+      if (m > LONG_MAX - d) {
+        break;
+      }
+    }
+  }
+
+  size_t count = 0;
+  for (size_t i = 0; i < span; i++) {
+    long n = a + (long) i;
+    if ((n >= 2 && !composite[i]) || n == 4) {
+      count++;
+    }
+  }
+  Candidate *candidates = malloc((count > 0 ? count : 1) * sizeof(Candidate));
+  if (candidates == NULL) {
+    free(composite);
+    return -1;
+  }
+  count = 0;
+  for (size_t i = 0; i < span; i++) {
+    long n = a + (long) i;
+    if ((n >= 2 && !composite[i]) || n == 4) {
+      candidates[count].index = n;
+      candidates[count].state = CANDIDATE_PENDING;
+      count++;
+    }
+  }
+  free(composite);
+
+  SearchQueue *queue = malloc(sizeof(SearchQueue));
+  if (queue == NULL) {
+    free(candidates);
+    return -1;
+  }
+  queue->candidates = candidates;
+  queue->count = count;
+  queue->next = 0;
+  queue->finished = 0;
+  queue->state_file = NULL;
+  queue->verbose = verbose;
+  queue->abandoned = 0;
+  queue->references = 1;
+  pthread_mutex_init(&queue->lock, NULL);
+  pthread_cond_init(&queue->idle, NULL);
+
+  if (state_path != NULL) {
+    if (load_search_state(state_path, a, b, candidates, count) != 0) {
+      fprintf(stderr, "Error: Search state '%s' belongs to a different range\n", state_path);
+      queue_release(queue);
+      return -1;
+    }
+    // Like the output file, never through a symlink
+    int fd = open(state_path, O_WRONLY | O_CREAT | O_APPEND | O_NOFOLLOW, 0644);
+    struct stat info;
+    int fresh = fd != -1 && fstat(fd, &info) == 0 && info.st_size == 0;
+    queue->state_file = fd != -1 ? fdopen(fd, "a") : NULL;
+    if (queue->state_file == NULL) {
+      fprintf(stderr, "Error: Cannot open search state '%s'\n", state_path);
+      if (fd != -1) {
+        close(fd);
+      }
+      queue_release(queue);
+      return -1;
+    }
+    if (fresh) {
+      fprintf(queue->state_file, SEARCH_STATE_MAGIC " %ld %ld\n", a, b);
+      fflush(queue->state_file);
+    }
+  }
+
+  for (size_t i = 0; i < count; i++) {
+    if (candidates[i].state != CANDIDATE_PENDING) {
+      queue->finished++;
+    }
+  }
+  if (verbose) {
+    fprintf(stderr, "Searching %zu candidate indices with %d threads (%zu already done)\n", count,
+            threads, queue->finished);
+  }
+
+  // Workers are detached: the calling thread waits on the reference count instead of joining,
+  // so it can give up on those still inside a test once the search is cancelled
+  int started = 0;
+  for (; started < threads; started++) {
+    pthread_t worker;
+    pthread_mutex_lock(&queue->lock);
+    queue->references++;
+    pthread_mutex_unlock(&queue->lock);
+    if (pthread_create(&worker, NULL, search_worker, queue) != 0) {
+      pthread_mutex_lock(&queue->lock);
+      queue->references--;
+      pthread_mutex_unlock(&queue->lock);
+      break;
+    }
+    pthread_detach(worker);
+  }
+  if (started == 0) {
+    // Fall back to searching on the calling thread
+    pthread_mutex_lock(&queue->lock);
+    queue->references++;
+    pthread_mutex_unlock(&queue->lock);
+    search_worker(queue);
+  }
+
+  pthread_mutex_lock(&queue->lock);
+  while (queue->references > 1 && !CALCULATION_CANCELLED()) {
+    struct timespec deadline;
+    clock_gettime(CLOCK_REALTIME, &deadline);
+    deadline.tv_nsec += SEARCH_POLL_NANOSECONDS;
+    if (deadline.tv_nsec >= 1000000000L) {
+      deadline.tv_sec++;
+      deadline.tv_nsec -= 1000000000L;
+    }
+    pthread_cond_timedwait(&queue->idle, &queue->lock, &deadline);
+  }
+  if (queue->state_file != NULL) {
+    fclose(queue->state_file);
+    queue->state_file = NULL;
+  }
+  size_t finished = queue->finished;
+  queue->abandoned = CALCULATION_CANCELLED();
+  pthread_mutex_unlock(&queue->lock);
+
+  if (CALCULATION_CANCELLED()) {
+    // A partial list would read as the answer for the whole range
+    fprintf(stderr, "Searched %zu of %zu candidate indices before the search was stopped%s\n",
+            finished, count, state_path != NULL ? "; rerun with the same --search-state to continue" : "");
+    queue_release(queue);
+    return 0;
+  }
+
+  int found = 0;
+  int written = 0;
+  for (size_t i = 0; i < count && written >= 0; i++) {
+    if (candidates[i].state == CANDIDATE_PRIME) {
+      found++;
+      if (raw_output) {
+        written = fprintf(output, "%ld\n", candidates[i].index);
+      } else {
+        written = fprintf(output, "Fibonacci Prime: F(%ld)\n", candidates[i].index);
+      }
+    }
+  }
+  if (written >= 0 && !raw_output) {
+    written = fprintf(output, "Found %d probable prime%s among F(%ld..%ld) (%zu candidate %s)\n",
+                      found, found == 1 ? "" : "s", a, b, count, count == 1 ? "index" : "indices");
+  }
+
+  queue_release(queue);
+  return written < 0 ? -1 : 0;
+}
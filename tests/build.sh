@@ -171,6 +171,586 @@ if run_test 10 "^0b110111$" "Fibonacci raw bin" "-f bin -r"; then
 fi
 ((total_tests++))
 
+echo -e "\n=== Leading digits tests ==="
+if run_test 1000 "Fibonacci Number 1000 (first 10 of 209 decimal digits): 4346655768" "Leading digits" "--leading 10"; then
+  ((passed_tests++))
+fi
+((total_tests++))
+
+if run_test 100000 "^2597406934$" "Leading digits raw (Binet path)" "--leading 10 -r"; then
+  ((passed_tests++))
+fi
+((total_tests++))
+
+if run_test 10 "^0x37$" "Leading digits longer than result" "--leading 5 -f hex -r"; then
+  ((passed_tests++))
+fi
+((total_tests++))
+
+echo -e "\n=== Digit count tests ==="
+if run_test 100000 "Fibonacci Number 100000 has 20899 decimal digits" "Digit count" "--digits"; then
+  ((passed_tests++))
+fi
+((total_tests++))
+
+if run_test 1000 "^694$" "Bit length raw" "--bits -r"; then
+  ((passed_tests++))
+fi
+((total_tests++))
+
+echo -e "\n=== Digit window tests ==="
+if run_test 100 "Fibonacci Number 100 (decimal digits 16-20): 35422" "Decimal digit window" "--digits-at 16:10"; then
+  ((passed_tests++))
+fi
+((total_tests++))
+
+if run_test 100 "^0x94bf$" "Hexadecimal digit window raw" "-f hex --digits-at 2:4 -r"; then
+  ((passed_tests++))
+fi
+((total_tests++))
+
+echo -e "\n=== Inverse lookup tests ==="
+if run_test 6765 "Fibonacci Index: 20" "Index of Fibonacci number" "--index-of"; then
+  ((passed_tests++))
+fi
+((total_tests++))
+
+echo -n "Testing --index-of with a non-Fibonacci value: "
+output=$(./fib --index-of 6766 -r)
+if [ "$output" == "not Fibonacci" ]; then
+  echo -e "${GREEN}SUCCESS${NC}"
+  ((passed_tests++))
+else
+  echo -e "${RED}FAILED${NC}"
+  echo "  Expected: not Fibonacci"
+  echo "  Obtained: $output"
+  failed_tests+=("Index of non-Fibonacci value - Incorrect output")
+fi
+((total_tests++))
+
+echo -n "Testing --index-of round trip through stdin: "
+output=$(./fib 12345 -r | ./fib --index-of - -r)
+if [ "$output" == "12345" ]; then
+  echo -e "${GREEN}SUCCESS${NC}"
+  ((passed_tests++))
+else
+  echo -e "${RED}FAILED${NC}"
+  echo "  Expected: 12345"
+  echo "  Obtained: $output"
+  failed_tests+=("Index of round trip - Incorrect output")
+fi
+((total_tests++))
+
+echo -e "\n=== Zeckendorf tests ==="
+if run_test 100 "Zeckendorf Representation: 1000010100" "Zeckendorf representation" "--zeckendorf"; then
+  ((passed_tests++))
+fi
+((total_tests++))
+
+echo -n "Testing --zeckendorf packed output: "
+output=$(./fib --zeckendorf 100 --packed | od -An -tx1 | tr -d ' \n')
+if [ "$output" == "1402" ]; then
+  echo -e "${GREEN}SUCCESS${NC}"
+  ((passed_tests++))
+else
+  echo -e "${RED}FAILED${NC}"
+  echo "  Expected: 1402"
+  echo "  Obtained: $output"
+  failed_tests+=("Packed Zeckendorf output - Incorrect output")
+fi
+((total_tests++))
+
+echo -e "\n=== Aggregate tests ==="
+echo -n "Testing --sum over a range: "
+output=$(./fib --sum 3:10 -r)
+if [ "$output" == "141" ]; then
+  echo -e "${GREEN}SUCCESS${NC}"
+  ((passed_tests++))
+else
+  echo -e "${RED}FAILED${NC}"
+  echo "  Expected: 141"
+  echo "  Obtained: $output"
+  failed_tests+=("Range sum - Incorrect output")
+fi
+((total_tests++))
+
+echo -n "Testing --alt-sum with a negative result: "
+output=$(./fib --alt-sum 0:5 -r)
+if [ "$output" == "-4" ]; then
+  echo -e "${GREEN}SUCCESS${NC}"
+  ((passed_tests++))
+else
+  echo -e "${RED}FAILED${NC}"
+  echo "  Expected: -4"
+  echo "  Obtained: $output"
+  failed_tests+=("Alternating sum - Incorrect output")
+fi
+((total_tests++))
+
+echo -n "Testing --sum-squares with --mod over a huge range: "
+output=$(./fib --sum-squares 1000000000000000000 --mod 1000000007 -r)
+if [ "$output" == "772414879" ]; then
+  echo -e "${GREEN}SUCCESS${NC}"
+  ((passed_tests++))
+else
+  echo -e "${RED}FAILED${NC}"
+  echo "  Expected: 772414879"
+  echo "  Obtained: $output"
+  failed_tests+=("Modular sum of squares - Incorrect output")
+fi
+((total_tests++))
+
+echo -e "\n=== Recurrence tests ==="
+if run_test 10 "Lucas Number 10 (decimal): 123" "Lucas preset" "--recurrence lucas"; then
+  ((passed_tests++))
+fi
+((total_tests++))
+
+if run_test 20 "Recurrence Term 20 (decimal): 35890" "Custom tribonacci recurrence" "--recurrence 1,1,1;0,0,1"; then
+  ((passed_tests++))
+fi
+((total_tests++))
+
+if run_test 5 "Recurrence Term 5 (hexadecimal): 0x5" "Recurrence with negative terms" "--recurrence 1,-2;1,1 -f hex"; then
+  ((passed_tests++))
+fi
+((total_tests++))
+
+echo -e "\n=== Verification tests ==="
+if run_test 1000 "Verification: passed" "Modular fingerprint verification" "--verify"; then
+  ((passed_tests++))
+fi
+((total_tests++))
+
+if run_test 5000 "Verification: passed" "Verification of the iterative algorithm" "--verify -a iter"; then
+  ((passed_tests++))
+fi
+((total_tests++))
+
+echo -n "Testing --verify draws 62-bit primes: "
+verify_primes=$(./fib 1000 --verify -v 2>&1 >/dev/null | sed -n 's/^Verified F(1000) mod \([0-9]*\) = .*/\1/p')
+verify_in_range=$(echo "$verify_primes" | awk 'BEGIN { n = 0 } length($0) > 0 { n++; if ($0 + 0 < 2^61 || $0 + 0 >= 2^62) bad = 1 } END { print (n == 4 && !bad) ? "yes" : "no" }')
+if [ "$verify_in_range" == "yes" ]; then
+  echo -e "${GREEN}SUCCESS${NC}"
+  ((passed_tests++))
+else
+  echo -e "${RED}FAILED${NC}"
+  failed_tests+=("Verify prime range - Primes outside [2^61, 2^62): $(echo $verify_primes)")
+fi
+((total_tests++))
+
+echo -e "\n=== Digest and digit statistics tests ==="
+if run_test 100 "Digest (SHA-256): 9f3cd0550139d594df1a95c59b7cac2469e3f594ead276485b23a5016f09e830" "SHA-256 digest" "--digest sha256"; then
+  ((passed_tests++))
+fi
+((total_tests++))
+
+if run_test 100 "Digit Counts: 0=1 1=3 2=3 3=1 4=3 5=3 6=1 7=2 8=2 9=2 (total 21)" "Digit statistics" "--digit-stats"; then
+  ((passed_tests++))
+fi
+((total_tests++))
+
+echo -n "Testing streamed digest matches the written digits: "
+streamed=$(./fib 50000 -T -r --digest xxh64 | head -1)
+written=$(./fib 50000 -r --digest xxh64 | tail -1)
+if [ -n "$streamed" ] && [ "$streamed" == "$written" ]; then
+  echo -e "${GREEN}SUCCESS${NC}"
+  ((passed_tests++))
+else
+  echo -e "${RED}FAILED${NC}"
+  echo "  Streamed: $streamed"
+  echo "  Written:  $written"
+  failed_tests+=("Streamed digest - Mismatch with written output")
+fi
+((total_tests++))
+
+echo -e "\n=== Prime search tests ==="
+echo -n "Testing --prime-search over F(1..600): "
+output=$(./fib --prime-search 1:600 --threads 2 -r | tr '\n' ' ')
+expected="3 4 5 7 11 13 17 23 29 43 47 83 131 137 359 431 433 449 509 569 571 "
+if [ "$output" == "$expected" ]; then
+  echo -e "${GREEN}SUCCESS${NC}"
+  ((passed_tests++))
+else
+  echo -e "${RED}FAILED${NC}"
+  echo "  Expected: $expected"
+  echo "  Obtained: $output"
+  failed_tests+=("Fibonacci prime search - Incorrect output")
+fi
+((total_tests++))
+
+echo -n "Testing --prime-search resume from a search state: "
+search_state_file="/tmp/fib_test_search_$$.txt"
+rm -f "$search_state_file"
+first=$(./fib --prime-search 100:1000 --search-state "$search_state_file" -r)
+resumed=$(./fib --prime-search 100:1000 --search-state "$search_state_file" -r)
+if [ -n "$first" ] && [ "$first" == "$resumed" ] && grep -q "^449 prime$" "$search_state_file"; then
+  echo -e "${GREEN}SUCCESS${NC}"
+  ((passed_tests++))
+else
+  echo -e "${RED}FAILED${NC}"
+  echo "  First run: $first"
+  echo "  Resumed:   $resumed"
+  failed_tests+=("Prime search resume - Results differ")
+fi
+rm -f "$search_state_file"
+((total_tests++))
+
+echo -n "Testing --search-state accepts an empty file and refuses a symlink: "
+: > "$search_state_file"
+empty_run=$(./fib --prime-search 10:50 --search-state "$search_state_file" -r 2>/dev/null)
+empty_status=$?
+ln -s "$search_state_file.target" "$search_state_file.link"
+./fib --prime-search 10:50 --search-state "$search_state_file.link" -r >/dev/null 2>&1
+link_status=$?
+if [ $empty_status -eq 0 ] && [ "$empty_run" == "$(./fib --prime-search 10:50 -r)" ] &&
+  [ "$(head -n 1 "$search_state_file")" == "fib-prime-search 1 10 50" ] &&
+  [ $link_status -ne 0 ] && [ ! -e "$search_state_file.target" ]; then
+  echo -e "${GREEN}SUCCESS${NC}"
+  ((passed_tests++))
+else
+  echo -e "${RED}FAILED${NC}"
+  failed_tests+=("Prime search state - Empty file rejected (status $empty_status) or symlink followed")
+fi
+rm -f "$search_state_file" "$search_state_file.link" "$search_state_file.target"
+((total_tests++))
+
+echo -e "\n=== Cache tests ==="
+echo -n "Testing --cache hits, steps and doubles match fresh results: "
+cache_home="/tmp/fib_test_cache_$$"
+mkdir -p "$cache_home"
+cache_ok=1
+for n in 20000 20000 20100 40001 19000; do
+  cached=$(HOME="$cache_home" ./fib "$n" -r --cache)
+  fresh=$(./fib "$n" -r)
+  if [ "$cached" != "$fresh" ]; then
+    cache_ok=0
+    echo "  Mismatch for F($n)"
+  fi
+done
+if [ $cache_ok -eq 1 ] && [ -f "$cache_home/.fib_cache/pair-20000.bin" ]; then
+  echo -e "${GREEN}SUCCESS${NC}"
+  ((passed_tests++))
+else
+  echo -e "${RED}FAILED${NC}"
+  failed_tests+=("Pair cache - Cached results differ from fresh ones")
+fi
+((total_tests++))
+
+echo -n "Testing --cache rejects a corrupted entry: "
+printf 'X' | dd of="$cache_home/.fib_cache/pair-20000.bin" bs=1 seek=200 conv=notrunc 2>/dev/null
+cached=$(HOME="$cache_home" ./fib 20000 -r -f hex --cache 2>/dev/null)
+hit=$(HOME="$cache_home" ./fib 20000 -r -f bin --cache -v 2>&1 >/dev/null | grep -c "Cache hit")
+if [ "$cached" == "$(./fib 20000 -r -f hex)" ] && [ "$hit" -eq 1 ]; then
+  echo -e "${GREEN}SUCCESS${NC}"
+  ((passed_tests++))
+else
+  echo -e "${RED}FAILED${NC}"
+  failed_tests+=("Pair cache - Corrupted entry was not replaced")
+fi
+((total_tests++))
+
+echo -n "Testing --cache rejects limb counts that wrap the payload size: "
+# A bare header with fn_limbs = 2^61 and fn1_limbs = 0: fn_limbs * 8 wraps to the empty
+# payload, and both checksums are the XXH64 of no bytes, so only the bounds check stops it
+le64() {
+  for shift in 0 8 16 24 32 40 48 56; do
+    printf "\\x$(printf %02x $((($1 >> shift) & 255)))"
+  done
+}
+pair_file="$cache_home/.fib_cache/pair-20000.bin"
+rm -f "$cache_home"/.fib_cache/render-20000-*
+truncate -s 64 "$pair_file"
+{ le64 $((1 << 61)); le64 0; le64 0xef46db3751d8e999; le64 0xef46db3751d8e999; } |
+  dd of="$pair_file" bs=1 seek=32 conv=notrunc 2>/dev/null
+cached=$(HOME="$cache_home" ./fib 20000 -r --cache 2>/dev/null)
+if [ $? -eq 0 ] && [ "$cached" == "$(./fib 20000 -r)" ]; then
+  echo -e "${GREEN}SUCCESS${NC}"
+  ((passed_tests++))
+else
+  echo -e "${RED}FAILED${NC}"
+  failed_tests+=("Pair cache - Wrapping limb counts were trusted")
+fi
+((total_tests++))
+
+echo -n "Testing --cache serves cached renderings to stdout and files: "
+render_ok=1
+for opts in "-f hex" "-f bin -r" "-r"; do
+  HOME="$cache_home" ./fib 3000 $opts --cache >/dev/null
+  served=$(HOME="$cache_home" ./fib 3000 $opts --cache -v 2>/dev/null)
+  if [ "$served" != "$(./fib 3000 $opts)" ]; then
+    render_ok=0
+    echo "  Mismatch for options $opts"
+  fi
+done
+render_file="/tmp/fib_test_render_$$.txt"
+HOME="$cache_home" ./fib 3000 --cache -o "$render_file"
+if [ "$(cat "$render_file")" != "$(./fib 3000)" ] ||
+  [ ! -f "$cache_home/.fib_cache/render-3000-hex-label.txt" ]; then
+  render_ok=0
+fi
+if [ $render_ok -eq 1 ]; then
+  echo -e "${GREEN}SUCCESS${NC}"
+  ((passed_tests++))
+else
+  echo -e "${RED}FAILED${NC}"
+  failed_tests+=("Rendered cache - Served output differs from fresh output")
+fi
+rm -f "$render_file"
+((total_tests++))
+
+echo -n "Testing --cache single flight across concurrent processes: "
+for i in 1 2 3 4; do
+  HOME="$cache_home" ./fib 400000 -r --cache -v >"$cache_home/out_$i" 2>"$cache_home/err_$i" &
+done
+wait
+computed=$(cat "$cache_home"/err_* | grep -c "Cached F(400000)")
+distinct=$(md5sum "$cache_home"/out_* | awk '{print $1}' | sort -u | wc -l)
+if [ "$computed" -eq 1 ] && [ "$distinct" -eq 1 ] &&
+  [ "$(cat "$cache_home/out_1")" == "$(./fib 400000 -r)" ]; then
+  echo -e "${GREEN}SUCCESS${NC}"
+  ((passed_tests++))
+else
+  echo -e "${RED}FAILED${NC}"
+  echo "  Computations: $computed, distinct outputs: $distinct"
+  failed_tests+=("Cache single flight - Concurrent processes recomputed")
+fi
+rm -rf "$cache_home"
+((total_tests++))
+
+echo -e "\n=== Checkpoint tests ==="
+echo -n "Testing --checkpoint and --resume reproduce the result: "
+checkpoint_file="/tmp/fib_test_checkpoint_$$.ckpt"
+rm -f "$checkpoint_file"
+full=$(./fib 200000 -r --checkpoint "$checkpoint_file" --checkpoint-interval 0)
+resumed=$(./fib 200000 -r --resume "$checkpoint_file")
+extended=$(./fib 400001 -r --resume "$checkpoint_file")
+if [ -f "$checkpoint_file" ] && [ "$full" == "$(./fib 200000 -r)" ] && [ "$resumed" == "$full" ] &&
+  [ "$extended" == "$(./fib 400001 -r)" ]; then
+  echo -e "${GREEN}SUCCESS${NC}"
+  ((passed_tests++))
+else
+  echo -e "${RED}FAILED${NC}"
+  failed_tests+=("Checkpoint - Resumed result differs")
+fi
+rm -f "$checkpoint_file"
+((total_tests++))
+
+echo -e "\n=== Out-of-core tests ==="
+echo -n "Testing --out-of-core streams the same result: "
+ooc_dir="/tmp/fib_test_ooc_$$"
+mkdir -p "$ooc_dir"
+# F(20000000) has blocks of about 1.7 MB, above the 1 MiB segment threshold
+ooc_dec=$(./fib 20000000 --out-of-core "$ooc_dir" --max-resident 1 -v 2>"$ooc_dir.err" | md5sum)
+ooc_hex=$(./fib 20000000 -f hex -r --out-of-core "$ooc_dir" --max-resident 1 | md5sum)
+ooc_peak=$(sed -n 's/^Peak file-backed memory: \([0-9]*\) bytes.*/\1/p' "$ooc_dir.err")
+if [ "$ooc_dec" == "$(./fib 20000000 | md5sum)" ] &&
+  [ "$ooc_hex" == "$(./fib 20000000 -f hex -r | md5sum)" ] && [ -z "$(ls -A "$ooc_dir")" ] &&
+  [ "${ooc_peak:-0}" -gt 0 ]; then
+  echo -e "${GREEN}SUCCESS${NC}"
+  ((passed_tests++))
+else
+  echo -e "${RED}FAILED${NC}"
+  failed_tests+=("Out-of-core - Result differs, segments were left behind or none were mapped")
+fi
+rm -rf "$ooc_dir" "$ooc_dir.err"
+((total_tests++))
+
+echo -e "\n=== Memory budget tests ==="
+echo -n "Testing --max-memory low-memory mode gives the same result: "
+low_output=$(./fib 40000000 -f hex --max-memory 32 -v 2>/tmp/fib_test_mem_$$)
+if grep -q "using low-memory mode" /tmp/fib_test_mem_$$ &&
+  [ "$(echo "$low_output" | head -n 1)" == "$(./fib 40000000 -f hex)" ] &&
+  echo "$low_output" | grep -q "^Predicted Peak Memory: " &&
+  echo "$low_output" | grep -q "^Actual Peak Memory: "; then
+  echo -e "${GREEN}SUCCESS${NC}"
+  ((passed_tests++))
+else
+  echo -e "${RED}FAILED${NC}"
+  failed_tests+=("Memory budget - Low-memory result or peak report differs")
+fi
+rm -f /tmp/fib_test_mem_$$
+((total_tests++))
+
+echo -n "Testing --max-memory refuses a run that cannot fit: "
+output=$(./fib 100000000 --max-memory 16 2>&1)
+if [ $? -ne 0 ] && echo "$output" | grep -q "even in low-memory mode"; then
+  echo -e "${GREEN}SUCCESS${NC}"
+  ((passed_tests++))
+else
+  echo -e "${RED}FAILED${NC}"
+  failed_tests+=("Memory budget - Oversized run was not refused")
+fi
+((total_tests++))
+
+echo -e "\n=== Allocator tests ==="
+echo -n "Testing --allocator arena gives the same results: "
+arena_ok=1
+for fmt in dec hex bin; do
+  if [ "$(./fib 2000000 -f $fmt --allocator arena | md5sum)" != "$(./fib 2000000 -f $fmt | md5sum)" ]; then
+    arena_ok=0
+  fi
+done
+arena_ckpt="/tmp/fib_test_arena_$$.ckpt"
+if [ "$(./fib 1000000 -r --allocator arena --checkpoint "$arena_ckpt" --checkpoint-interval 0 |
+  md5sum)" != "$(./fib 1000000 -r | md5sum)" ]; then
+  arena_ok=0
+fi
+rm -f "$arena_ckpt"
+if [ $arena_ok -eq 1 ]; then
+  echo -e "${GREEN}SUCCESS${NC}"
+  ((passed_tests++))
+else
+  echo -e "${RED}FAILED${NC}"
+  failed_tests+=("Allocator - Arena result differs")
+fi
+((total_tests++))
+
+echo -n "Testing --alloc-stats=json reports every phase: "
+stats_json=$(./fib 200000 --alloc-stats=json 2>&1 >/dev/null)
+if echo "$stats_json" | grep -q '"peak_live_bytes": [1-9]' &&
+  echo "$stats_json" | grep -q '"compute": {"allocations": [1-9]' &&
+  echo "$stats_json" | grep -q '"conversion": ' && echo "$stats_json" | grep -q '"output": ' &&
+  [ "$(./fib 200000 --alloc-stats 2>/dev/null)" == "$(./fib 200000)" ]; then
+  echo -e "${GREEN}SUCCESS${NC}"
+  ((passed_tests++))
+else
+  echo -e "${RED}FAILED${NC}"
+  failed_tests+=("Allocator - Allocation statistics missing or output changed")
+fi
+((total_tests++))
+
+echo -e "\n=== Timing tests ==="
+echo -n "Testing --timing=json reports every phase: "
+timing_json=$(./fib 300000 -a iter --timing=json 2>&1 >/dev/null)
+timing_ok=1
+for phase in parse compute verify conversion output history; do
+  if ! echo "$timing_json" | grep -q "\"$phase\": {\"wall_seconds\": [0-9.]*, \"thread_cpu_seconds\""; then
+    timing_ok=0
+  fi
+done
+if [ $timing_ok -eq 1 ] && echo "$timing_json" | grep -q '"algorithm": "iter"' &&
+  echo "$timing_json" | grep -q '"result_bits": 208272'; then
+  echo -e "${GREEN}SUCCESS${NC}"
+  ((passed_tests++))
+else
+  echo -e "${RED}FAILED${NC}"
+  failed_tests+=("Timing - JSON phase report incomplete")
+fi
+((total_tests++))
+
+echo -n "Testing --perf-counters reports counters or degrades: "
+perf_stderr=$(./fib 100000 --perf-counters 2>&1 >/dev/null)
+if [ "$(./fib 100000 --perf-counters 2>/dev/null | md5sum)" == "$(./fib 100000 | md5sum)" ] &&
+  { echo "$perf_stderr" | grep -q "^compute " ||
+    echo "$perf_stderr" | grep -q "Hardware counters are not available"; }; then
+  echo -e "${GREEN}SUCCESS${NC}"
+  ((passed_tests++))
+else
+  echo -e "${RED}FAILED${NC}"
+  failed_tests+=("Timing - Hardware counter report missing or output changed")
+fi
+((total_tests++))
+
+echo -n "Testing SIGUSR1 dumps progress without disturbing the result: "
+progress_file="/tmp/fib_test_progress_$$"
+./fib 600000 -a iter >"$progress_file.out" 2>"$progress_file.err" &
+progress_pid=$!
+sleep 0.3
+kill -USR1 "$progress_pid" 2>/dev/null
+wait "$progress_pid"
+if grep -q "Progress: iterative: [0-9]* of 600000 iterations" "$progress_file.err" &&
+  [ "$(md5sum <"$progress_file.out")" == "$(./fib 600000 -a iter | md5sum)" ]; then
+  echo -e "${GREEN}SUCCESS${NC}"
+  ((passed_tests++))
+else
+  echo -e "${RED}FAILED${NC}"
+  failed_tests+=("Progress - SIGUSR1 dump missing or output changed")
+fi
+rm -f "$progress_file.out" "$progress_file.err"
+((total_tests++))
+
+echo -n "Testing SIGUSR1 is answered outside the engines: "
+progress_file="/tmp/fib_test_progress_$$"
+./fib 30000000 -v >"$progress_file.out" 2>"$progress_file.err" &
+progress_pid=$!
+for _ in $(seq 200); do
+  grep -q "Calculation complete" "$progress_file.err" && break
+  sleep 0.05
+done
+kill -USR1 "$progress_pid" 2>/dev/null
+wait "$progress_pid"
+progress_status=$?
+./fib --prime-search 1:3000 -r >"$progress_file.search" 2>"$progress_file.err2" &
+search_pid=$!
+sleep 0.2
+kill -USR1 "$search_pid" 2>/dev/null
+wait "$search_pid"
+search_status=$?
+if [ $progress_status -eq 0 ] && [ $search_status -eq 0 ] &&
+  grep -q "Progress: no calculation running; [a-z]* phase" "$progress_file.err" &&
+  grep -q "Progress: " "$progress_file.err2" && [ "$(wc -l <"$progress_file.search")" -eq 22 ]; then
+  echo -e "${GREEN}SUCCESS${NC}"
+  ((passed_tests++))
+else
+  echo -e "${RED}FAILED${NC}"
+  failed_tests+=("Progress - SIGUSR1 outside an engine killed the run or went unanswered")
+fi
+rm -f "$progress_file.out" "$progress_file.err" "$progress_file.search" "$progress_file.err2"
+((total_tests++))
+
+echo -n "Testing --timeout stops a long calculation with status 124: "
+timeout_stderr=$(./fib 100000000 -a iter --timeout 0.2 2>&1 >/dev/null)
+timeout_status=$?
+if [ $timeout_status -eq 124 ] && echo "$timeout_stderr" | grep -q "Error: Timed out after 0.2 seconds" &&
+  echo "$timeout_stderr" | grep -q "Progress: iterative: [0-9]* of 100000000 iterations" &&
+  echo "$timeout_stderr" | grep -q "^compute " &&
+  [ "$(./fib 1000 --timeout 60 | md5sum)" == "$(./fib 1000 | md5sum)" ]; then
+  echo -e "${GREEN}SUCCESS${NC}"
+  ((passed_tests++))
+else
+  echo -e "${RED}FAILED${NC}"
+  failed_tests+=("Timeout - Expiry not reported or status $timeout_status")
+fi
+((total_tests++))
+
+echo -n "Testing --timeout stops a recurrence and the query modes: "
+timeout_stderr=$(./fib 300000000 --recurrence tribonacci --timeout 0.2 2>&1 >/dev/null)
+timeout_status=$?
+search_stderr=$(./fib --prime-search 1:200000 --timeout 0.3 2>&1 >/dev/null)
+search_status=$?
+sum_stderr=$(./fib --sum 1:300000000 --timeout 0.2 2>&1 >/dev/null)
+sum_status=$?
+if [ $timeout_status -eq 124 ] && echo "$timeout_stderr" | grep -q "Error: Timed out after 0.2 seconds" &&
+  echo "$timeout_stderr" | grep -q "Progress: recurrence: [0-9]* of [0-9]* squarings" &&
+  [ $search_status -eq 124 ] && echo "$search_stderr" | grep -q "Error: Timed out after 0.3 seconds" &&
+  [ $sum_status -eq 124 ] && echo "$sum_stderr" | grep -q "Error: Timed out after 0.2 seconds" &&
+  [ "$(./fib 1000 --recurrence tribonacci --timeout 60 | md5sum)" == \
+    "$(./fib 1000 --recurrence tribonacci | md5sum)" ]; then
+  echo -e "${GREEN}SUCCESS${NC}"
+  ((passed_tests++))
+else
+  echo -e "${RED}FAILED${NC}"
+  failed_tests+=("Timeout - Recurrence or query mode ran on (status $timeout_status, $search_status, $sum_status)")
+fi
+((total_tests++))
+
+echo -n "Testing --trace writes matrix and phase spans: "
+trace_file="/tmp/fib_test_trace_$$.json"
+if [ "$(./fib 500000 --trace "$trace_file" | md5sum)" == "$(./fib 500000 | md5sum)" ] &&
+  grep -q '"traceEvents"' "$trace_file" && grep -q '"name": "matrix_multiply", "ph": "X"' "$trace_file" &&
+  grep -q '"name": "compute", "ph": "X"' "$trace_file" &&
+  grep -q '"name": "parse", "ph": "X", "pid": 1, "tid": 1, "ts": 0.000' "$trace_file" &&
+  ! ./fib 10 --trace /tmp 2>/dev/null; then
+  echo -e "${GREEN}SUCCESS${NC}"
+  ((passed_tests++))
+else
+  echo -e "${RED}FAILED${NC}"
+  failed_tests+=("Trace - Missing spans or output changed")
+fi
+rm -f "$trace_file"
+((total_tests++))
+
 echo -e "\n=== Flag tests ==="
 
 echo -n "Testing with -h flag: "
@@ -749,6 +1329,137 @@ else
 fi
 ((total_tests++))
 
+echo -n "Testing invalid --leading digit count: "
+if ! ./fib --leading 0 10 >/dev/null 2>&1; then
+  echo -e "${GREEN}SUCCESS: Program correctly detected the error${NC}"
+  ((passed_tests++))
+else
+  echo -e "${RED}FAILED: Program should have failed with zero leading digits${NC}"
+  failed_tests+=("Invalid leading digit count - Did not fail as expected")
+fi
+((total_tests++))
+
+echo -n "Testing --digits-at beyond the result: "
+if ! ./fib --digits-at 21:1 100 >/dev/null 2>&1; then
+  echo -e "${GREEN}SUCCESS: Program correctly detected the error${NC}"
+  ((passed_tests++))
+else
+  echo -e "${RED}FAILED: Program should have failed with an out-of-range window${NC}"
+  failed_tests+=("Out-of-range digit window - Did not fail as expected")
+fi
+((total_tests++))
+
+echo -n "Testing --packed without --zeckendorf: "
+if ! ./fib --packed 10 >/dev/null 2>&1; then
+  echo -e "${GREEN}SUCCESS: Program correctly detected the error${NC}"
+  ((passed_tests++))
+else
+  echo -e "${RED}FAILED: Program should have failed without --zeckendorf${NC}"
+  failed_tests+=("Packed without Zeckendorf - Did not fail as expected")
+fi
+((total_tests++))
+
+echo -n "Testing --mod without an aggregate: "
+if ! ./fib --mod 7 10 >/dev/null 2>&1; then
+  echo -e "${GREEN}SUCCESS: Program correctly detected the error${NC}"
+  ((passed_tests++))
+else
+  echo -e "${RED}FAILED: Program should have failed without an aggregate option${NC}"
+  failed_tests+=("Modulus without aggregate - Did not fail as expected")
+fi
+((total_tests++))
+
+echo -n "Testing --recurrence with mismatched seeds: "
+if ! ./fib --recurrence "1,1;0" 10 >/dev/null 2>&1; then
+  echo -e "${GREEN}SUCCESS: Program correctly detected the error${NC}"
+  ((passed_tests++))
+else
+  echo -e "${RED}FAILED: Program should have failed with a malformed recurrence${NC}"
+  failed_tests+=("Malformed recurrence - Did not fail as expected")
+fi
+((total_tests++))
+
+echo -n "Testing --verify with a query option: "
+if ! ./fib --verify --digits 100 >/dev/null 2>&1; then
+  echo -e "${GREEN}SUCCESS: Program correctly detected the error${NC}"
+  ((passed_tests++))
+else
+  echo -e "${RED}FAILED: Program should have failed for a query without a full result${NC}"
+  failed_tests+=("Verify with query option - Did not fail as expected")
+fi
+((total_tests++))
+
+echo -n "Testing --threads without --prime-search: "
+if ! ./fib --threads 4 10 >/dev/null 2>&1; then
+  echo -e "${GREEN}SUCCESS: Program correctly detected the error${NC}"
+  ((passed_tests++))
+else
+  echo -e "${RED}FAILED: Program should have failed without --prime-search${NC}"
+  failed_tests+=("Threads without prime search - Did not fail as expected")
+fi
+((total_tests++))
+
+echo -n "Testing --cache with a query option: "
+output=$(./fib 100 --digits --cache 2>&1)
+if [ $? -ne 0 ] && echo "$output" | grep -q "Error: --cache applies only"; then
+  echo -e "${GREEN}SUCCESS: Program correctly rejected --cache with --digits${NC}"
+  ((passed_tests++))
+else
+  echo -e "${RED}FAILED: Program should have rejected --cache with --digits${NC}"
+  failed_tests+=("Cache with query - Should have failed")
+fi
+((total_tests++))
+
+echo -n "Testing --checkpoint-interval without --checkpoint: "
+if ! ./fib --checkpoint-interval 5 10 >/dev/null 2>&1; then
+  echo -e "${GREEN}SUCCESS: Program correctly detected the error${NC}"
+  ((passed_tests++))
+else
+  echo -e "${RED}FAILED: Program should have failed without --checkpoint${NC}"
+  failed_tests+=("Checkpoint interval without checkpoint - Did not fail as expected")
+fi
+((total_tests++))
+
+echo -n "Testing --max-memory with --cache: "
+if ! ./fib 100 --max-memory 64 --cache >/dev/null 2>&1; then
+  echo -e "${GREEN}SUCCESS: Program correctly detected the error${NC}"
+  ((passed_tests++))
+else
+  echo -e "${RED}FAILED: Program should have rejected --max-memory with --cache${NC}"
+  failed_tests+=("Memory budget with cache - Did not fail as expected")
+fi
+((total_tests++))
+
+echo -n "Testing unknown allocator: "
+if ! ./fib 10 --allocator slab >/dev/null 2>&1; then
+  echo -e "${GREEN}SUCCESS: Program correctly detected the error${NC}"
+  ((passed_tests++))
+else
+  echo -e "${RED}FAILED: Program should have rejected the allocator name${NC}"
+  failed_tests+=("Unknown allocator - Did not fail as expected")
+fi
+((total_tests++))
+
+echo -n "Testing --alloc-stats with a query option: "
+if ! ./fib 100 --digits --alloc-stats >/dev/null 2>&1; then
+  echo -e "${GREEN}SUCCESS: Program correctly detected the error${NC}"
+  ((passed_tests++))
+else
+  echo -e "${RED}FAILED: Program should have rejected --alloc-stats with --digits${NC}"
+  failed_tests+=("Allocation statistics with query - Did not fail as expected")
+fi
+((total_tests++))
+
+echo -n "Testing invalid --timeout: "
+if ! ./fib 10 --timeout 0 >/dev/null 2>&1 && ./fib 10 --timeout abc 2>&1 | grep -q "Invalid seconds"; then
+  echo -e "${GREEN}SUCCESS${NC}"
+  ((passed_tests++))
+else
+  echo -e "${RED}FAILED${NC}"
+  failed_tests+=("Timeout - Invalid seconds accepted")
+fi
+((total_tests++))
+
 echo -n "Testing invalid format name: "
 if ! ./fib -f invalid_format 10 >/dev/null 2>&1; then
   echo -e "${GREEN}SUCCESS: Program correctly detected the error${NC}"
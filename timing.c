@@ -0,0 +1,243 @@
+#include "fib.h"
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#ifdef __linux__
+#include <linux/perf_event.h>
+#include <sys/syscall.h>
+#endif
+
+static const char *const phase_names[PHASES] = {"parse",      "compute", "verify",
+                                                "conversion", "output",  "history"};
+
+static const char *const counter_names[COUNTERS] = {"cycles", "instructions", "llc_misses",
+                                                    "dtlb_misses", "branch_misses"};
+
+static double clock_seconds(clockid_t clock) {
+  struct timespec now;
+  if (clock_gettime(clock, &now) != 0) {
+    return 0.0;
+  }
+  return (double) now.tv_sec + (double) now.tv_nsec / 1e9;
+}
+
+double monotonic_seconds(void) {
+  return clock_seconds(CLOCK_MONOTONIC);
+}
+
+/**
+ * Reads a counter with the times it was enabled and running, so a counter the kernel had to
+ * multiplex can be scaled up to the whole interval.
+ *
+ * @return 0 on success, -1 if the counter is closed or the read failed
+ */
+static int read_counter(int fd, uint64_t sample[3]) {
+  if (fd < 0) {
+    return -1;
+  }
+  return read(fd, sample, 3 * sizeof(uint64_t)) == (ssize_t) (3 * sizeof(uint64_t)) ? 0 : -1;
+}
+
+static void counters_begin(PhaseTimer *timer) {
+  for (int i = 0; i < COUNTERS; i++) {
+    if (read_counter(timer->counter_fds[i], timer->counter_start[i]) != 0) {
+      memset(timer->counter_start[i], 0, sizeof(timer->counter_start[i]));
+    }
+  }
+}
+
+static void counters_end(PhaseTimer *timer) {
+  for (int i = 0; i < COUNTERS; i++) {
+    uint64_t now[3];
+    if (read_counter(timer->counter_fds[i], now) != 0) {
+      continue;
+    }
+    uint64_t value = now[0] - timer->counter_start[i][0];
+    uint64_t enabled = now[1] - timer->counter_start[i][1];
+    uint64_t running = now[2] - timer->counter_start[i][2];
+    if (running > 0 && running < enabled) {
+      value = (uint64_t) ((double) value * (double) enabled / (double) running);
+    }
+    timer->counts[timer->current][i] += value;
+  }
+}
+
+void phase_timer_init(PhaseTimer *timer) {
+  for (int i = 0; i < PHASES; i++) {
+    timer->wall_seconds[i] = 0.0;
+    timer->thread_cpu_seconds[i] = 0.0;
+    timer->process_cpu_seconds[i] = 0.0;
+    for (int c = 0; c < COUNTERS; c++) {
+      timer->counts[i][c] = 0;
+    }
+  }
+  for (int c = 0; c < COUNTERS; c++) {
+    timer->counter_fds[c] = -1;
+  }
+  timer->current = -1;
+  timer->trace_start = 0.0;
+}
+
+int phase_timer_enable_counters(PhaseTimer *timer) {
+  int opened = 0;
+#ifdef __linux__
+  static const struct {
+    uint32_t type;
+    uint64_t config;
+  } events[COUNTERS] = {
+      {PERF_TYPE_HARDWARE, PERF_COUNT_HW_CPU_CYCLES},
+      {PERF_TYPE_HARDWARE, PERF_COUNT_HW_INSTRUCTIONS},
+      {PERF_TYPE_HW_CACHE, PERF_COUNT_HW_CACHE_LL | (PERF_COUNT_HW_CACHE_OP_READ << 8) |
+                               (PERF_COUNT_HW_CACHE_RESULT_MISS << 16)},
+      {PERF_TYPE_HW_CACHE, PERF_COUNT_HW_CACHE_DTLB | (PERF_COUNT_HW_CACHE_OP_READ << 8) |
+                               (PERF_COUNT_HW_CACHE_RESULT_MISS << 16)},
+      {PERF_TYPE_HARDWARE, PERF_COUNT_HW_BRANCH_MISSES},
+  };
+
+  // Each counter is opened on its own rather than as a group, so one the CPU or hypervisor
+  // lacks does not take the rest down with it. User space only, which perf_event_paranoid 2
+  // still allows; inherit folds in the worker threads once they are joined
+  for (int c = 0; c < COUNTERS; c++) {
+    struct perf_event_attr attr;
+    memset(&attr, 0, sizeof(attr));
+    attr.size = sizeof(attr);
+    attr.type = events[c].type;
+    attr.config = events[c].config;
+    attr.read_format = PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING;
+    attr.exclude_kernel = 1;
+    attr.exclude_hv = 1;
+    attr.inherit = 1;
+    long fd = syscall(SYS_perf_event_open, &attr, 0, -1, -1, 0);
+    timer->counter_fds[c] = (int) fd;
+    if (fd >= 0) {
+      opened++;
+    }
+  }
+#endif
+  if (timer->current >= 0) {
+    counters_begin(timer);
+  }
+  return opened;
+}
+
+void phase_timer_close_counters(PhaseTimer *timer) {
+  for (int c = 0; c < COUNTERS; c++) {
+    if (timer->counter_fds[c] >= 0) {
+      close(timer->counter_fds[c]);
+      timer->counter_fds[c] = -1;
+    }
+  }
+}
+
+void phase_timer_begin(PhaseTimer *timer, Phase phase) {
+  phase_timer_end(timer);
+  timer->current = (int) phase;
+  progress_phase(phase_names[phase]);
+  timer->trace_start = trace_begin();
+  counters_begin(timer);
+  timer->wall_start = monotonic_seconds();
+  timer->thread_cpu_start = clock_seconds(CLOCK_THREAD_CPUTIME_ID);
+  timer->process_cpu_start = clock_seconds(CLOCK_PROCESS_CPUTIME_ID);
+}
+
+void phase_timer_end(PhaseTimer *timer) {
+  if (timer->current < 0) {
+    return;
+  }
+  // Phases can be entered more than once (output around the history update); times add up
+  timer->wall_seconds[timer->current] += monotonic_seconds() - timer->wall_start;
+  timer->thread_cpu_seconds[timer->current] +=
+      clock_seconds(CLOCK_THREAD_CPUTIME_ID) - timer->thread_cpu_start;
+  timer->process_cpu_seconds[timer->current] +=
+      clock_seconds(CLOCK_PROCESS_CPUTIME_ID) - timer->process_cpu_start;
+  counters_end(timer);
+  trace_end(phase_names[timer->current], timer->trace_start, NULL, 0, NULL, 0);
+  timer->current = -1;
+  progress_phase(NULL);
+}
+
+static int counters_enabled(const PhaseTimer *timer) {
+  for (int c = 0; c < COUNTERS; c++) {
+    if (timer->counter_fds[c] >= 0) {
+      return 1;
+    }
+  }
+  return 0;
+}
+
+static double instructions_per_cycle(const PhaseTimer *timer, int phase) {
+  uint64_t cycles = timer->counts[phase][COUNTER_CYCLES];
+  return cycles > 0 ? (double) timer->counts[phase][COUNTER_INSTRUCTIONS] / (double) cycles : 0.0;
+}
+
+int phase_timer_report_json(const PhaseTimer *timer, FILE *output, long n, const char *engine,
+                            OutputFormat format, const mpz_t result) {
+  double total = 0.0;
+  int status = fprintf(output,
+                       "{\"n\": %ld, \"algorithm\": \"%s\", \"format\": \"%s\", "
+                       "\"result_bits\": %zu, \"result_bytes\": %zu, \"phases\": {",
+                       n, engine, format_to_string(format), mpz_sizeinbase(result, 2),
+                       mpz_size(result) * sizeof(mp_limb_t)) < 0;
+  for (int i = 0; i < PHASES; i++) {
+    total += timer->wall_seconds[i];
+    status |= fprintf(output,
+                      "%s\"%s\": {\"wall_seconds\": %.9f, \"thread_cpu_seconds\": %.9f, "
+                      "\"process_cpu_seconds\": %.9f",
+                      i > 0 ? ", " : "", phase_names[i], timer->wall_seconds[i],
+                      timer->thread_cpu_seconds[i], timer->process_cpu_seconds[i]) < 0;
+    if (counters_enabled(timer)) {
+      // Counters that could not be opened are null rather than a misleading zero
+      status |= fprintf(output, ", \"counters\": {") < 0;
+      for (int c = 0; c < COUNTERS; c++) {
+        if (timer->counter_fds[c] >= 0) {
+          status |= fprintf(output, "\"%s\": %llu, ", counter_names[c],
+                            (unsigned long long) timer->counts[i][c]) < 0;
+        } else {
+          status |= fprintf(output, "\"%s\": null, ", counter_names[c]) < 0;
+        }
+      }
+      status |= fprintf(output, "\"ipc\": %.3f}", instructions_per_cycle(timer, i)) < 0;
+    }
+    status |= fputc('}', output) == EOF;
+  }
+  status |= fprintf(output, "}, \"total_wall_seconds\": %.9f}\n", total) < 0;
+  return status ? -1 : 0;
+}
+
+int phase_timer_report_text(const PhaseTimer *timer, FILE *output) {
+  int status = 0;
+  for (int i = 0; i < PHASES; i++) {
+    if (timer->wall_seconds[i] > 0.0) {
+      status |= fprintf(output, "%-10s %10.3f s wall %10.3f s CPU\n", phase_names[i],
+                        timer->wall_seconds[i], timer->process_cpu_seconds[i]) < 0;
+    }
+  }
+  return status ? -1 : 0;
+}
+
+int phase_timer_report_counters(const PhaseTimer *timer, FILE *output) {
+  int status = fprintf(output, "%-10s %15s %15s %6s %12s %12s %13s\n", "Phase", "Cycles",
+                       "Instructions", "IPC", "LLC misses", "dTLB misses", "Branch misses") < 0;
+  for (int i = 0; i < PHASES; i++) {
+    status |= fprintf(output, "%-10s", phase_names[i]) < 0;
+    for (int c = 0; c < COUNTERS; c++) {
+      int width = c <= COUNTER_INSTRUCTIONS ? 15 : c == COUNTER_BRANCH_MISSES ? 13 : 12;
+      if (timer->counter_fds[c] >= 0) {
+        status |= fprintf(output, " %*llu", width, (unsigned long long) timer->counts[i][c]) < 0;
+      } else {
+        status |= fprintf(output, " %*s", width, "-") < 0;
+      }
+      if (c == COUNTER_INSTRUCTIONS) {
+        if (timer->counter_fds[COUNTER_CYCLES] >= 0 &&
+            timer->counter_fds[COUNTER_INSTRUCTIONS] >= 0) {
+          status |= fprintf(output, " %6.2f", instructions_per_cycle(timer, i)) < 0;
+        } else {
+          status |= fprintf(output, " %6s", "-") < 0;
+        }
+      }
+    }
+    status |= fputc('\n', output) == EOF;
+  }
+  return status ? -1 : 0;
+}
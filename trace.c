@@ -0,0 +1,164 @@
+#include "fib.h"
+
+#ifndef FIB_NO_TRACE
+
+#include <fcntl.h>
+#include <pthread.h>
+#include <stdlib.h>
+#include <time.h>
+#include <unistd.h>
+
+#ifndef O_NOFOLLOW
+#define O_NOFOLLOW 0
+#endif
+
+// Events kept per thread; older ones are overwritten once a thread records more
+#define TRACE_RING_EVENTS (1 << 16)
+
+typedef struct {
+  const char *name;
+  double start;  // microseconds since the trace origin
+  double duration;
+  const char *arg_names[2];
+  long args[2];
+} TraceEvent;
+
+// One ring per thread, written only by its thread and read once all threads are done
+typedef struct TraceRing {
+  struct TraceRing *next;
+  int tid;
+  unsigned long long recorded;
+  TraceEvent events[TRACE_RING_EVENTS];
+} TraceRing;
+
+static struct {
+  int enabled;
+  FILE *file;
+  double origin;
+  TraceRing *rings;  // pushed lock-free as threads first record
+  int next_tid;
+  pthread_key_t key;
+} tracer;
+
+static double now_microseconds(void) {
+  struct timespec now;
+  clock_gettime(CLOCK_MONOTONIC, &now);
+  return (double) now.tv_sec * 1e6 + (double) now.tv_nsec / 1e3;
+}
+
+static TraceRing *current_ring(void) {
+  TraceRing *ring = pthread_getspecific(tracer.key);
+  if (ring == NULL) {
+    ring = malloc(sizeof(TraceRing));
+    if (ring == NULL) {
+      return NULL;
+    }
+    ring->recorded = 0;
+    ring->tid = __atomic_add_fetch(&tracer.next_tid, 1, __ATOMIC_RELAXED);
+    ring->next = __atomic_load_n(&tracer.rings, __ATOMIC_RELAXED);
+    while (!__atomic_compare_exchange_n(&tracer.rings, &ring->next, ring, 1, __ATOMIC_RELEASE,
+                                        __ATOMIC_RELAXED)) {
+    }
+    pthread_setspecific(tracer.key, ring);
+  }
+  return ring;
+}
+
+static void write_event(FILE *file, const TraceEvent *event, int tid, int *first) {
+  fprintf(file, "%s\n{\"name\": \"%s\", \"ph\": \"X\", \"pid\": 1, \"tid\": %d, \"ts\": %.3f, "
+                "\"dur\": %.3f, \"args\": {",
+          *first ? "" : ",", event->name, tid, event->start, event->duration);
+  for (int i = 0; i < 2 && event->arg_names[i] != NULL; i++) {
+    fprintf(file, "%s\"%s\": %ld", i > 0 ? ", " : "", event->arg_names[i], event->args[i]);
+  }
+  fprintf(file, "}}");
+  *first = 0;
+}
+
+/**
+ * Writes every ring to the trace file as Chrome trace-event JSON. Runs at exit, after the
+ * helper threads have been joined, so no ring is still being written.
+ */
+static void flush_trace(void) {
+  if (!tracer.enabled) {
+    return;
+  }
+  tracer.enabled = 0;
+
+  FILE *file = tracer.file;
+  unsigned long long dropped = 0;
+  int first = 1;
+  fprintf(file, "{\"traceEvents\": [");
+  for (TraceRing *ring = tracer.rings; ring != NULL; ring = ring->next) {
+    fprintf(file, "%s\n{\"name\": \"thread_name\", \"ph\": \"M\", \"pid\": 1, \"tid\": %d, "
+                  "\"args\": {\"name\": \"%s %d\"}}",
+            first ? "" : ",", ring->tid, ring->tid == 1 ? "main" : "worker", ring->tid);
+    first = 0;
+    unsigned long long begin = 0;
+    if (ring->recorded > TRACE_RING_EVENTS) {
+      begin = ring->recorded - TRACE_RING_EVENTS;
+      dropped += begin;
+    }
+    for (unsigned long long i = begin; i < ring->recorded; i++) {
+      write_event(file, &ring->events[i % TRACE_RING_EVENTS], ring->tid, &first);
+    }
+  }
+  fprintf(file, "\n], \"displayTimeUnit\": \"ms\", \"otherData\": {\"dropped_events\": %llu}}\n",
+          dropped);
+  if (fclose(file) != 0) {
+    fprintf(stderr, "Warning: Cannot write the trace file\n");
+  }
+}
+
+int trace_open(const char *path, double origin) {
+  // Open now so a bad path fails before the computation rather than after it; like the
+  // output file, never through a symlink
+  int fd = open(path, O_WRONLY | O_CREAT | O_TRUNC | O_NOFOLLOW, 0644);
+  if (fd == -1) {
+    return -1;
+  }
+  tracer.file = fdopen(fd, "w");
+  if (tracer.file == NULL) {
+    close(fd);
+    return -1;
+  }
+  if (pthread_key_create(&tracer.key, NULL) != 0) {
+    fclose(tracer.file);
+    return -1;
+  }
+  tracer.origin = origin * 1e6;
+  tracer.enabled = 1;
+  atexit(flush_trace);
+  return 0;
+}
+
+double trace_begin(void) {
+  return tracer.enabled ? now_microseconds() : 0.0;
+}
+
+double trace_begin_at(double seconds) {
+  return tracer.enabled ? seconds * 1e6 : 0.0;
+}
+
+void trace_end(const char *name, double start, const char *arg_name, long arg,
+               const char *arg2_name, long arg2) {
+  if (start == 0.0) {
+    return;
+  }
+  double end = now_microseconds();
+  TraceRing *ring = current_ring();
+  if (ring == NULL) {
+    return;
+  }
+  TraceEvent *event = &ring->events[ring->recorded % TRACE_RING_EVENTS];
+  event->name = name;
+  event->start = start - tracer.origin;
+  event->duration = end - start;
+  event->arg_names[0] = arg_name;
+  event->args[0] = arg;
+  event->arg_names[1] = arg2_name;
+  event->args[1] = arg2;
+  ring->recorded++;
+}
+
+#endif
@@ -217,7 +217,7 @@ void run_user_interface(int *argc, char ***argv) {
       case 'f':
       case 'F':
         if (current_view == VIEW_MAIN) {
-          calculate_result(&config);
+          calculate_result(main_win, &config);
         }
         break;
 
@@ -1,6 +1,7 @@
 #include "ui_handlers.h"
 #include "ui_input.h"
 #include "fib.h"
+#include <pthread.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
@@ -29,12 +30,23 @@ void cycle_format(char *format) {
   }
 }
 
-void calculate_result(UIConfig *config) {
-  // Free previous result if exists
-  if (config->result_string) {
-    free(config->result_string);
-    config->result_string = NULL;
-  }
+// One calculation run off the UI thread, so the UI can keep reading keys and cancel it
+typedef struct {
+  const UIConfig *config;
+  OutputFormat format;
+  int use_arena;
+  double calc_time;
+  char *raw_result;  // NULL when cancelled
+  int done;
+} CalculationJob;
+
+/**
+ * Computes and formats the result. The mpz values live and die on this thread, so under
+ * FIB_ALLOCATOR=arena its arena is empty and released when the thread exits.
+ */
+static void *run_calculation(void *arg) {
+  CalculationJob *job = arg;
+  const UIConfig *config = job->config;
 
   mpz_t result;
   mpz_init(result);
@@ -43,8 +55,19 @@ void calculate_result(UIConfig *config) {
   struct timespec start, end;
   clock_gettime(CLOCK_MONOTONIC, &start);
 
-  // Select algorithm
-  if (strcmp(config->algorithm, "iter") == 0) {
+  // Select algorithm; with FIB_CACHE set (size budget in MiB) results come from and go to
+  // the shared cache, so the TUI also waits for concurrent processes computing the same n
+  const char *cache_env = getenv("FIB_CACHE");
+  unsigned long long cache_mib = cache_env != NULL ? strtoull(cache_env, NULL, 10) : 0;
+  if (cache_mib > 0) {
+    Algorithm algo = MATRIX;
+    if (strcmp(config->algorithm, "iter") == 0) {
+      algo = ITERATIVE;
+    } else if (strcmp(config->algorithm, "recur") == 0) {
+      algo = RECURSIVE;
+    }
+    calculate_fibonacci_cached(result, config->fib_number, algo, cache_mib << 20, 0);
+  } else if (strcmp(config->algorithm, "iter") == 0) {
     calculate_fibonacci_iterative(result, config->fib_number, 0);
   } else if (strcmp(config->algorithm, "recur") == 0) {
     calculate_fibonacci_recursive(result, config->fib_number, NULL, 0);
@@ -53,9 +76,31 @@ void calculate_result(UIConfig *config) {
   }
 
   clock_gettime(CLOCK_MONOTONIC, &end);
-  config->calc_time = (end.tv_sec - start.tv_sec) + (end.tv_nsec - start.tv_nsec) / 1e9;
+  job->calc_time = (end.tv_sec - start.tv_sec) + (end.tv_nsec - start.tv_nsec) / 1e9;
+
+  job->raw_result = CALCULATION_CANCELLED() ? NULL : get_formatted_result(result, job->format, 0);
+  mpz_clear(result);
+  if (job->use_arena) {
+    memory_arena_reset();
+  }
+  __atomic_store_n(&job->done, 1, __ATOMIC_RELEASE);
+  return NULL;
+}
+
+void calculate_result(WINDOW *win, UIConfig *config) {
+  // Free previous result if exists
+  if (config->result_string) {
+    free(config->result_string);
+    config->result_string = NULL;
+  }
+
+  // FIB_ALLOCATOR=arena serves GMP from per-thread arenas, reset after each calculation
+  const char *allocator_env = getenv("FIB_ALLOCATOR");
+  int use_arena = allocator_env != NULL && strcmp(allocator_env, "arena") == 0;
+  if (use_arena) {
+    memory_use_arena(0);
+  }
 
-  // Format the result
   OutputFormat fmt = DECIMAL;
   if (strcmp(config->format, "hex") == 0) {
     fmt = HEXADECIMAL;
@@ -63,7 +108,36 @@ void calculate_result(UIConfig *config) {
     fmt = BINARY;
   }
 
-  char *raw_result = get_formatted_result(result, fmt, 0);
+  // The engines check calculation_cancelled between steps; ESC sets it
+  CalculationJob job = {config, fmt, use_arena, 0.0, NULL, 0};
+  calculation_reset();
+  pthread_t worker;
+  if (pthread_create(&worker, NULL, run_calculation, &job) == 0) {
+    wattron(win, COLOR_PAIR(COLOR_PAIR_DIM));
+    mvwprintw(win, getmaxy(win) - 2, 2, "%-*s", getmaxx(win) - 4, "Calculating... Abort: ESC");
+    wattroff(win, COLOR_PAIR(COLOR_PAIR_DIM));
+    wrefresh(win);
+    wtimeout(win, 100);
+    while (!__atomic_load_n(&job.done, __ATOMIC_ACQUIRE)) {
+      if (wgetch(win) == 27) {
+        calculation_cancel();
+      }
+    }
+    wtimeout(win, -1);
+    pthread_join(worker, NULL);
+  } else {
+    run_calculation(&job);
+  }
+  config->calc_time = job.calc_time;
+
+  if (CALCULATION_CANCELLED()) {
+    calculation_reset();
+    config->result_string = strdup("Calculation aborted");
+    config->has_result = 1;
+    return;
+  }
+
+  char *raw_result = job.raw_result;
 
   // Build the final result string based on raw_output setting
   if (config->raw_output) {
@@ -126,8 +200,6 @@ void calculate_result(UIConfig *config) {
       }
     }
   }
-
-  mpz_clear(result);
 }
 
 void handle_history_up(int *history_selected, int *history_scroll) {
@@ -241,7 +313,7 @@ void handle_enter_key(WINDOW *main_win, UIConfig *config, int selected_field) {
       }
       break;
     case FIELD_CONFIRM:
-      calculate_result(config);
+      calculate_result(main_win, config);
       break;
   }
 }
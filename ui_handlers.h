@@ -6,7 +6,7 @@
 
 void cycle_algorithm(char *algorithm);
 void cycle_format(char *format);
-void calculate_result(UIConfig *config);
+void calculate_result(WINDOW *win, UIConfig *config);
 void handle_history_up(int *history_selected, int *history_scroll);
 void handle_history_down(int *history_selected, int *history_scroll, int max_y);
 void handle_history_delete(int *history_selected, int *history_scroll);
@@ -1,4 +1,5 @@
 #include "fib.h"
+#include "probes.h"
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
@@ -8,6 +9,11 @@
 #include <fcntl.h>
 #include <limits.h>
 
+#ifdef FIB_USDT
+// The semaphores of the probes in probes.h
+FIB_PROBES(FIB_PROBE_SEMAPHORE)
+#endif
+
 // Sanitize and validate a path from untrusted input
 // Returns a newly allocated canonical path or NULL if validation fails
 static char *sanitize_path(const char *untrusted_path) {
@@ -92,6 +98,32 @@ static char *get_history_file_path(void) {
   return path;
 }
 
+char *get_cache_directory(void) {
+  // The cache lives next to the history file: ~/.fib_cache beside ~/.fib_history
+  char *path = get_history_file_path();
+  if (!path) {
+    return NULL;
+  }
+
+  char *slash = strrchr(path, '/');
+  size_t len = (size_t) (slash - path) + strlen("/.fib_cache") + 1;
+  char *dir = malloc(len);
+  if (!dir) {
+    free(path);
+    return NULL;
+  }
+  snprintf(dir, len, "%.*s/.fib_cache", (int) (slash - path), path);
+  free(path);
+
+  // Create it on first use, private to the user
+  struct stat st;
+  if (mkdir(dir, S_IRWXU) != 0 && (stat(dir, &st) != 0 || !S_ISDIR(st.st_mode))) {
+    free(dir);
+    return NULL;
+  }
+  return dir;
+}
+
 const char *algorithm_to_string(Algorithm algo) {
   switch (algo) {
     case ITERATIVE:
@@ -118,7 +150,10 @@ const char *format_to_string(OutputFormat fmt) {
   }
 }
 
-int load_history(HistoryEntry **history, int *count) {
+/**
+ * Reads the history file; load_history wraps it with the history load probes.
+ */
+static int read_history_file(HistoryEntry **history, int *count) {
   char *history_path = get_history_file_path();
   if (!history_path) {
     return -1;
@@ -185,7 +220,10 @@ int load_history(HistoryEntry **history, int *count) {
   return 0;
 }
 
-int save_history(const HistoryEntry *history, int count) {
+/**
+ * Writes the history file; save_history wraps it with the history save probes.
+ */
+static int write_history_file(const HistoryEntry *history, int count) {
   if (count < 0 || count > MAX_HISTORY_ENTRIES) {
     return -1;
   }
@@ -224,6 +262,20 @@ int save_history(const HistoryEntry *history, int count) {
   return 0;
 }
 
+int load_history(HistoryEntry **history, int *count) {
+  FIB_PROBE0(history__load__start);
+  int status = read_history_file(history, count);
+  FIB_PROBE2(history__load__done, status, status == 0 ? *count : 0);
+  return status;
+}
+
+int save_history(const HistoryEntry *history, int count) {
+  FIB_PROBE1(history__save__start, count);
+  int status = write_history_file(history, count);
+  FIB_PROBE1(history__save__done, status);
+  return status;
+}
+
 int add_to_history(long fib_number, Algorithm algorithm, OutputFormat format, double calc_time,
                    const char *result_str) {
   HistoryEntry *history = NULL;
@@ -344,7 +396,8 @@ void display_help(const char *program_name) {
   printf("                Show only calculation time (no result output).\n");
   printf("                Useful for stress testing and benchmarking.\n");
   printf("  -r, --raw     Output only the number without prefix.\n");
-  printf("  -v, --verbose Show detailed information during calculation.\n");
+  printf("  -v, --verbose Show detailed information during calculation, with\n");
+  printf("                progress and ETA each second (SIGUSR1 prints it on demand).\n");
   printf("  -o, --output  Save the result to the specified file.\n");
   printf("  -f, --format <format>\n");
   printf("                Set output number format. Available options:\n");
@@ -356,6 +409,97 @@ void display_help(const char *program_name) {
   printf("                  iter   - Iterative\n");
   printf("                  recur  - Recursive with memoization\n");
   printf("                  matrix - Matrix exponentiation (default)\n");
+  printf("  --leading <k> Print only the first k digits of the result, evaluated\n");
+  printf("                from Binet's formula without computing the full number.\n");
+  printf("  --digits      Print only the number of digits of the result in the\n");
+  printf("                selected format, without computing the full number.\n");
+  printf("  --bits        Print only the bit length of the result.\n");
+  printf("  --digits-at <pos:len>\n");
+  printf("                Print only len digits of the result, skipping the pos\n");
+  printf("                least significant digits.\n");
+  printf("  --index-of <value>\n");
+  printf("                Print n such that F(n) = value, or \"not Fibonacci\".\n");
+  printf("                Accepts decimal, 0x hex or 0b binary; - reads stdin and\n");
+  printf("                @file reads GMP raw format.\n");
+  printf("  --zeckendorf <value>\n");
+  printf("                Print the Zeckendorf representation of value, from the\n");
+  printf("                highest Fibonacci index down to F(2). Same inputs as --index-of.\n");
+  printf("  --packed      With --zeckendorf, write the digits as packed bytes, bit j\n");
+  printf("                (least significant first) being the coefficient of F(j + 2).\n");
+  printf("  --sum <[a:]b> Print F(a) + ... + F(b) from closed-form identities (a defaults\n");
+  printf("                to 0). Costs a few F evaluations instead of b - a additions.\n");
+  printf("  --sum-squares <[a:]b>\n");
+  printf("                Print F(a)^2 + ... + F(b)^2.\n");
+  printf("  --alt-sum <[a:]b>\n");
+  printf("                Print the alternating sum (-1)^a F(a) + ... + (-1)^b F(b).\n");
+  printf("  --mod <m>     Reduce an aggregate modulo m; only O(log b) small operations.\n");
+  printf("  --recurrence <spec>\n");
+  printf("                Compute term n of a(n) = c1 a(n-1) + ... + ck a(n-k) given as\n");
+  printf("                \"c1,...,ck;a(0),...,a(k-1)\", or one of the presets lucas, pell,\n");
+  printf("                pell-lucas, jacobsthal, padovan, tribonacci, tetranacci.\n");
+  printf("  --verify      Check the result modulo random 62-bit primes against an\n");
+  printf("                independent modular computation.\n");
+  printf("  --digest <algo>\n");
+  printf("                Print a digest of the result digits (no prefix or newline).\n");
+  printf("                Valid options: sha256, xxh64\n");
+  printf("  --digit-stats Print how often each digit occurs in the result.\n");
+  printf("                With -T both stream the digits without building the string.\n");
+  printf("  --prime-search <[a:]b>\n");
+  printf("                List the n in a..b for which F(n) is a probable prime. Only\n");
+  printf("                n = 4 and prime n are tried; candidate factors 2kn +- 1 are\n");
+  printf("                sieved out before the primality test.\n");
+  printf("  --threads <count>\n");
+  printf("                Worker threads for --prime-search (default: online CPUs).\n");
+  printf("  --search-state <file>\n");
+  printf("                Record --prime-search results in file; rerunning with the same\n");
+  printf("                range and file resumes where the previous run stopped.\n");
+  printf("  --cache       Reuse (F(k), F(k + 1)) pairs saved in ~/.fib_cache: an exact\n");
+  printf("                entry is copied, nearby ones are stepped or doubled from.\n");
+  printf("                Repeat queries copy the cached output without converting.\n");
+  printf("  --cache-size <MiB>\n");
+  printf("                Size budget of the cache, least recently used entries are\n");
+  printf("                evicted beyond it (default: 256). Implies --cache.\n");
+  printf("  --checkpoint <file>\n");
+  printf("                Compute by fast doubling and save the ladder state to file\n");
+  printf("                periodically from a background thread.\n");
+  printf("  --checkpoint-interval <secs>\n");
+  printf("                Seconds between checkpoints (default: 60).\n");
+  printf("  --resume <file>\n");
+  printf("                Continue from a checkpoint whose index prefixes n in binary.\n");
+  printf("  --out-of-core <dir>\n");
+  printf("                Keep GMP blocks of 1 MiB or more in unlinked files mapped from\n");
+  printf("                dir and stream the digits from them when writing the result.\n");
+  printf("  --max-resident <MiB>\n");
+  printf("                Page out the oldest mapped blocks beyond this (default: 1024).\n");
+  printf("                Best effort: checked whenever GMP allocates a large block, and\n");
+  printf("                the operands of the multiplication in progress stay resident.\n");
+  printf("  --max-memory <MiB>\n");
+  printf("                Predict the peak memory of the run and refuse it if it exceeds\n");
+  printf("                the budget, switching to in-place doubling and streamed digits\n");
+  printf("                first when that fits. Reports predicted and actual peaks.\n");
+  printf("  --allocator <name>\n");
+  printf("                GMP allocator: system (malloc) or arena, per-thread size\n");
+  printf("                classes with large blocks in 2 MiB aligned huge-page mappings\n");
+  printf("                (default: $FIB_ALLOCATOR, else system).\n");
+  printf("  --alloc-stats[=json]\n");
+  printf("                Report GMP allocations on stderr at exit: size histogram,\n");
+  printf("                reallocations and bytes they copied, peak live bytes, and a\n");
+  printf("                breakdown by phase (compute, conversion, output).\n");
+  printf("  --timing=json\n");
+  printf("                Report monotonic wall time and thread and process CPU time of\n");
+  printf("                each phase (parse, compute, verify, conversion, output, history)\n");
+  printf("                with the result size and algorithm, as JSON on stderr.\n");
+  printf("  --perf-counters\n");
+  printf("                Count cycles, instructions, LLC, dTLB and branch misses in each\n");
+  printf("                phase with perf_event_open; a table on stderr, or inside the\n");
+  printf("                --timing=json report. Unavailable counters show as - or null.\n");
+  printf("  --trace <file>\n");
+  printf("                Write Chrome/Perfetto trace events to file at exit: every phase,\n");
+  printf("                matrix multiply and power level or doubling step, conversion\n");
+  printf("                subtree and streamed output chunk, with operand sizes.\n");
+  printf("  --timeout <secs>\n");
+  printf("                Stop the calculation once secs have passed since start and\n");
+  printf("                exit with status 124, reporting progress and phase times.\n");
   printf("\n");
   printf("Examples:\n");
   printf("  %s 100                 Calculate using default algorithm\n", program_name);
@@ -365,44 +509,145 @@ void display_help(const char *program_name) {
   printf("  %s 20 -f bin -r        Display raw binary result\n", program_name);
   printf("  %s 30 -a recur -t      Calculate recursively and show time\n", program_name);
   printf("  %s 1000000 -T          Stress test - show only time\n", program_name);
+  printf("  %s 1000000000 --leading 20\n", program_name);
+  printf("                         First 20 digits of F(10^9)\n");
+  printf("  %s --index-of 6765     Find the index of a Fibonacci number\n", program_name);
+  printf("  %s --sum 10:20         Sum F(10) through F(20)\n", program_name);
+  printf("  %s 100 --recurrence pell\n", program_name);
+  printf("                         The 100th Pell number\n");
   printf("\n");
 }
 
 char *get_formatted_result(mpz_t result, OutputFormat format, int verbose) {
-  char *result_str = NULL;
+  int base = 10;
 
   switch (format) {
     case DECIMAL:
       if (verbose) {
         fprintf(stderr, "Converting result to decimal format\n");
       }
-      result_str = mpz_get_str(NULL, 10, result);
       break;
 
     case HEXADECIMAL:
       if (verbose) {
         fprintf(stderr, "Converting result to hexadecimal format\n");
       }
-      result_str = mpz_get_str(NULL, 16, result);
+      base = 16;
       break;
 
     case BINARY:
       if (verbose) {
         fprintf(stderr, "Converting result to binary format\n");
       }
-      result_str = mpz_get_str(NULL, 2, result);
+      base = 2;
       break;
 
     default:
       if (verbose) {
         fprintf(stderr, "Unknown format, defaulting to decimal\n");
       }
-      result_str = mpz_get_str(NULL, 10, result);
   }
 
+  // Convert into a malloc buffer rather than letting GMP allocate the string, so callers can
+  // free() it whichever GMP memory functions are installed (sign and terminator included)
+  char *result_str = malloc(mpz_sizeinbase(result, base) + 2);
+  if (result_str != NULL) {
+    double span = trace_begin();
+    FIB_PROBE2(format__start, base, (long) mpz_size(result));
+    mpz_get_str(result_str, base, result);
+    if (FIB_PROBE_ENABLED(format__done)) {
+      FIB_PROBE2(format__done, base, (long) strlen(result_str));
+    }
+    trace_end("mpz_get_str", span, "base", base, "limbs", (long) mpz_size(result));
+  }
   return result_str;
 }
 
+/**
+ * Parses text as a non-negative integer with an optional 0x or 0b prefix.
+ * Surrounding whitespace is ignored.
+ */
+static int parse_big_integer_text(mpz_t value, char *text) {
+  const char *blanks = " \t\r\n";
+  char *start = text + strspn(text, blanks);
+  char *end = start + strlen(start);
+  while (end > start && strchr(blanks, end[-1]) != NULL) {
+    *--end = '\0';
+  }
+
+  int base = 10;
+  if (start[0] == '0' && (start[1] == 'x' || start[1] == 'X')) {
+    base = 16;
+    start += 2;
+  } else if (start[0] == '0' && (start[1] == 'b' || start[1] == 'B')) {
+    base = 2;
+    start += 2;
+  }
+
+  // mpz_set_str accepts signs and inner whitespace, neither of which is a valid input here
+  if (start[0] == '\0' || strspn(start, "0123456789abcdefABCDEF") != strlen(start)) {
+    return -1;
+  }
+  return mpz_set_str(value, start, base);
+}
+
+int read_big_integer(mpz_t value, const char *spec) {
+  if (spec == NULL || spec[0] == '\0') {
+    return -1;
+  }
+
+  // @FILE: GMP raw format as written by mpz_out_raw (size header followed by limb bytes)
+  if (spec[0] == '@') {
+    FILE *fp = fopen(spec + 1, "rb");
+    if (fp == NULL) {
+      perror(spec + 1);
+      return -1;
+    }
+    size_t read = mpz_inp_raw(value, fp);
+    fclose(fp);
+    return read == 0 ? -1 : 0;
+  }
+
+  // -: text read from stdin, for numbers too large for the command line
+  if (strcmp(spec, "-") == 0) {
+    size_t capacity = 4096;
+    size_t length = 0;
+    char *buffer = malloc(capacity);
+    if (buffer == NULL) {
+      return -1;
+    }
+
+    size_t chunk;
+    while ((chunk = fread(buffer + length, 1, capacity - length - 1, stdin)) > 0) {
+      length += chunk;
+      if (capacity - length - 1 == 0) {
+        char *grown = realloc(buffer, capacity * 2);
+        if (grown == NULL) {
+          free(buffer);
+          return -1;
+        }
+        buffer = grown;
+        capacity *= 2;
+      }
+    }
+    buffer[length] = '\0';
+
+    int status = parse_big_integer_text(value, buffer);
+    free(buffer);
+    return status;
+  }
+
+  size_t spec_len = strlen(spec);
+  char *copy = malloc(spec_len + 1);
+  if (copy == NULL) {
+    return -1;
+  }
+  memcpy(copy, spec, spec_len + 1);
+  int status = parse_big_integer_text(value, copy);
+  free(copy);
+  return status;
+}
+
 const char *get_format_prefix(OutputFormat format) {
   switch (format) {
     case HEXADECIMAL:
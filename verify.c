@@ -0,0 +1,106 @@
+#include "fib.h"
+#include <stdio.h>
+#include <time.h>
+#include <unistd.h>
+
+// Number of random primes to fingerprint against; a wrong result slips past one prime with
+// probability about bits(F(n)) / 2^61
+#define VERIFY_PRIMES 4
+#define VERIFY_PRIME_BITS 62
+
+/**
+ * Sets fn = F(n) mod p and fn1 = F(n + 1) mod p by fast doubling, independently of the
+ * matrix code used by the main algorithms:
+ *   F(2k) = F(k) (2 F(k + 1) - F(k)),  F(2k + 1) = F(k)^2 + F(k + 1)^2
+ */
+static void fibonacci_mod_doubling(mpz_t fn, mpz_t fn1, long n, const mpz_t p) {
+  mpz_t even, odd;
+  mpz_init(even);
+  mpz_init(odd);
+
+  mpz_set_ui(fn, 0);
+  mpz_set_ui(fn1, 1);
+  for (int bit = (int) sizeof(long) * 8 - 2; bit >= 0; bit--) {
+    mpz_mul_2exp(even, fn1, 1);
+    mpz_sub(even, even, fn);
+    mpz_mul(even, even, fn);
+    mpz_mod(even, even, p);
+
+    mpz_mul(odd, fn, fn);
+    mpz_addmul(odd, fn1, fn1);
+    mpz_mod(odd, odd, p);
+
+    if ((n >> bit) & 1) {
+      mpz_add(fn1, even, odd);
+      mpz_mod(fn1, fn1, p);
+      mpz_swap(fn, odd);
+    } else {
+      mpz_swap(fn, even);
+      mpz_swap(fn1, odd);
+    }
+  }
+
+  mpz_clear(even);
+  mpz_clear(odd);
+}
+
+/**
+ * Seeds the prime generator from /dev/urandom, falling back to the clock and process id.
+ */
+static void seed_random(gmp_randstate_t state) {
+  unsigned long seed = 0;
+  FILE *urandom = fopen("/dev/urandom", "rb");
+  if (urandom == NULL || fread(&seed, sizeof(seed), 1, urandom) != 1) {
+    seed = (unsigned long) time(NULL) ^ ((unsigned long) getpid() << 16) ^ (unsigned long) clock();
+  }
+  if (urandom != NULL) {
+    fclose(urandom);
+  }
+  gmp_randseed_ui(state, seed);
+}
+
+int fibonacci_verify(const mpz_t result, long n, int verbose) {
+  if (n < 0) {
+    return -1;
+  }
+
+  gmp_randstate_t state;
+  gmp_randinit_default(state);
+  seed_random(state);
+
+  mpz_t prime, residue, fn, fn1;
+  mpz_init(prime);
+  mpz_init(residue);
+  mpz_init(fn);
+  mpz_init(fn1);
+
+  int status = 0;
+  for (int i = 0; i < VERIFY_PRIMES && status == 0; i++) {
+    // Random prime just above a random point in [2^61, 2^62)
+    mpz_urandomb(prime, state, VERIFY_PRIME_BITS);
+    mpz_setbit(prime, VERIFY_PRIME_BITS - 1);
+    mpz_nextprime(prime, prime);
+
+    // One pass over the limbs of the result
+    mpz_mod(residue, result, prime);
+    fibonacci_mod_doubling(fn, fn1, n, prime);
+
+    if (mpz_cmp(residue, fn) != 0) {
+      gmp_fprintf(stderr, "Error: Verification failed: F(%ld) mod %Zd is %Zd, expected %Zd\n", n,
+                  prime, residue, fn);
+      status = 1;
+      break;
+    }
+
+    if (verbose) {
+      gmp_fprintf(stderr, "Verified F(%ld) mod %Zd = %Zd\n", n, prime, residue);
+    }
+  }
+
+  mpz_clear(prime);
+  mpz_clear(residue);
+  mpz_clear(fn);
+  mpz_clear(fn1);
+  gmp_randclear(state);
+  return status;
+}
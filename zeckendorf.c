@@ -0,0 +1,227 @@
+#include "fib.h"
+#include <limits.h>
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+// Fibonacci numbers that fit in an unsigned long, for the greedy base case
+#define ZECK_SMALL_MAX 100
+
+// Powers Q^(2^e) of the Fibonacci Q-matrix; only F(2^e) and F(2^e - 1) are needed
+#define ZECK_LADDER_MAX 64
+
+typedef struct {
+  unsigned char *digits;  // digits[i] is the coefficient of F(i + 2)
+  size_t capacity;
+  unsigned long small[ZECK_SMALL_MAX];
+  int small_count;
+  mpz_t fib_shift[ZECK_LADDER_MAX];       // F(2^e)
+  mpz_t fib_shift_prev[ZECK_LADDER_MAX];  // F(2^e - 1)
+  int ladder_count;
+} ZeckendorfContext;
+
+/**
+ * Squares the ladder up to Q^(2^e) with the existing matrix machinery.
+ */
+static void ladder_extend(ZeckendorfContext *ctx, int e) {
+  mpz_t f_next, f_cur, f_prev, c11, c12, c21, c22;
+  mpz_init(f_next);
+  mpz_init(f_cur);
+  mpz_init(f_prev);
+  mpz_init(c11);
+  mpz_init(c12);
+  mpz_init(c21);
+  mpz_init(c22);
+
+  while (ctx->ladder_count <= e) {
+    int last = ctx->ladder_count - 1;
+    // Q^(2^last) = [[F(s+1), F(s)], [F(s), F(s-1)]]
+    mpz_add(f_next, ctx->fib_shift[last], ctx->fib_shift_prev[last]);
+    mpz_set(f_cur, ctx->fib_shift[last]);
+    mpz_set(f_prev, ctx->fib_shift_prev[last]);
+    matrix_multiply(f_next, f_cur, f_cur, f_prev, f_next, f_cur, f_cur, f_prev, c11, c12, c21,
+                    c22);
+
+    mpz_init_set(ctx->fib_shift[ctx->ladder_count], c12);
+    mpz_init_set(ctx->fib_shift_prev[ctx->ladder_count], c22);
+    ctx->ladder_count++;
+  }
+
+  mpz_clear(f_next);
+  mpz_clear(f_cur);
+  mpz_clear(f_prev);
+  mpz_clear(c11);
+  mpz_clear(c12);
+  mpz_clear(c21);
+  mpz_clear(c22);
+}
+
+/**
+ * Greedy decomposition for values that fit in a machine word.
+ */
+static void decompose_small(ZeckendorfContext *ctx, unsigned long value, size_t shift) {
+  for (int i = ctx->small_count - 1; i >= 2 && value > 0; i--) {
+    if (ctx->small[i] <= value) {
+      value -= ctx->small[i];
+      ctx->digits[shift + (size_t) i - 2] = 1;
+      i--;
+    }
+  }
+}
+
+/**
+ * Sets high = F(s) * L(a) + F(s - 1) * a, the value obtained by shifting every index in the
+ * Zeckendorf representation of a up by s = 2^e. L(a) = floor((a + 1) * phi) - 1 is the shift
+ * by one, computed exactly as floor((y + isqrt(5 y^2)) / 2) - 1 with y = a + 1.
+ */
+static void shifted_value(mpz_t high, const mpz_t a, ZeckendorfContext *ctx, int e, mpz_t tmp) {
+  mpz_add_ui(high, a, 1);
+  mpz_mul(tmp, high, high);
+  mpz_mul_ui(tmp, tmp, 5);
+  mpz_sqrt(tmp, tmp);
+  mpz_add(tmp, tmp, high);
+  mpz_fdiv_q_2exp(tmp, tmp, 1);
+  mpz_sub_ui(tmp, tmp, 1);
+
+  mpz_mul(high, tmp, ctx->fib_shift[e]);
+  mpz_addmul(high, a, ctx->fib_shift_prev[e]);
+}
+
+/**
+ * Decomposes value into digits at indices shift + 2 and above.
+ *
+ * The value splits as value = H + r where H uses only indices >= s + 2 and r < F(s + 2).
+ * H is the largest index-shifted image of some integer a that does not exceed value, so
+ * a (about half the size) and r (about half the size) are decomposed independently. Each
+ * level costs a constant number of multiplications, giving O(M(n) log n) overall.
+ */
+static void decompose(ZeckendorfContext *ctx, mpz_t value, size_t shift) {
+  if (mpz_fits_ulong_p(value)) {
+    decompose_small(ctx, mpz_get_ui(value), shift);
+    return;
+  }
+  // Once cancelled, the remaining halves are left undecomposed
+  if (CALCULATION_CANCELLED()) {
+    return;
+  }
+
+  // Index of the top digit: F(k) ~ phi^k / sqrt(5)
+  double top = ((double) mpz_sizeinbase(value, 2) * log(2.0) + 0.5 * log(5.0)) /
+               log((1.0 + sqrt(5.0)) / 2.0);
+  int e = 0;
+  while (e + 1 < ZECK_LADDER_MAX && (double) (1UL << (e + 1)) <= top / 2.0) {
+    e++;
+  }
+  if (e >= ctx->ladder_count) {
+    ladder_extend(ctx, e);
+  }
+  size_t s = (size_t) 1 << e;
+
+  mpz_t a, high, next, tmp;
+  mpz_init(a);
+  mpz_init(high);
+  mpz_init(next);
+  mpz_init(tmp);
+
+  // Estimate a = value / phi^s with phi^s = F(s) * phi + F(s - 1), in fixed point with
+  // enough bits for the quotient to be within one of the exact value
+  size_t value_bits = mpz_sizeinbase(value, 2);
+  size_t shift_bits = mpz_sizeinbase(ctx->fib_shift[e], 2);
+  mp_bitcnt_t prec = (mp_bitcnt_t) (value_bits > shift_bits ? value_bits - shift_bits : 0) + 64;
+  mpz_set_ui(tmp, 5);
+  mpz_mul_2exp(tmp, tmp, 2 * prec);
+  mpz_sqrt(tmp, tmp);
+  mpz_set_ui(next, 1);
+  mpz_mul_2exp(next, next, prec);
+  mpz_add(tmp, tmp, next);
+  mpz_fdiv_q_2exp(tmp, tmp, 1);
+  mpz_mul(high, tmp, ctx->fib_shift[e]);
+  mpz_mul_2exp(tmp, ctx->fib_shift_prev[e], prec);
+  mpz_add(high, high, tmp);
+  mpz_mul_2exp(a, value, prec);
+  mpz_fdiv_q(a, a, high);
+
+  // Correct the estimate to the largest a whose shifted image does not exceed value
+  shifted_value(high, a, ctx, e, tmp);
+  while (mpz_cmp(high, value) > 0) {
+    mpz_sub_ui(a, a, 1);
+    shifted_value(high, a, ctx, e, tmp);
+  }
+  for (;;) {
+    mpz_add_ui(a, a, 1);
+    shifted_value(next, a, ctx, e, tmp);
+    if (mpz_cmp(next, value) > 0) {
+      mpz_sub_ui(a, a, 1);
+      break;
+    }
+    mpz_swap(high, next);
+  }
+
+  mpz_sub(value, value, high);
+  mpz_clear(high);
+  mpz_clear(next);
+  mpz_clear(tmp);
+
+  decompose(ctx, value, shift);
+  decompose(ctx, a, shift + s);
+  mpz_clear(a);
+}
+
+unsigned char *zeckendorf_representation(const mpz_t value, size_t *count, int verbose) {
+  *count = 0;
+  if (mpz_sgn(value) < 0) {
+    return NULL;
+  }
+
+  ZeckendorfContext ctx;
+  ctx.small[0] = 0;
+  ctx.small[1] = 1;
+  ctx.small_count = 2;
+  while (ctx.small_count < ZECK_SMALL_MAX &&
+         ctx.small[ctx.small_count - 1] <= ULONG_MAX - ctx.small[ctx.small_count - 2]) {
+    ctx.small[ctx.small_count] = ctx.small[ctx.small_count - 1] + ctx.small[ctx.small_count - 2];
+    ctx.small_count++;
+  }
+
+  // Q^1 = [[F(2), F(1)], [F(1), F(0)]]
+  mpz_init_set_ui(ctx.fib_shift[0], 1);
+  mpz_init_set_ui(ctx.fib_shift_prev[0], 0);
+  ctx.ladder_count = 1;
+
+  // Top index is at most log_phi(value * sqrt(5)) + 1; leave a little slack
+  ctx.capacity = (size_t) ((double) mpz_sizeinbase(value, 2) * 1.4405) + 8;
+  ctx.digits = calloc(ctx.capacity, 1);
+  if (ctx.digits == NULL) {
+    mpz_clear(ctx.fib_shift[0]);
+    mpz_clear(ctx.fib_shift_prev[0]);
+    return NULL;
+  }
+
+  if (verbose) {
+    fprintf(stderr, "Decomposing a %zu-bit value into Fibonacci digits\n",
+            mpz_sizeinbase(value, 2));
+  }
+
+  mpz_t work;
+  mpz_init_set(work, value);
+  decompose(&ctx, work, 0);
+  mpz_clear(work);
+
+  if (verbose) {
+    fprintf(stderr, "Used %d ladder entries up to Q^(2^%d)\n", ctx.ladder_count,
+            ctx.ladder_count - 1);
+  }
+
+  for (int i = 0; i < ctx.ladder_count; i++) {
+    mpz_clear(ctx.fib_shift[i]);
+    mpz_clear(ctx.fib_shift_prev[i]);
+  }
+
+  size_t digits = ctx.capacity;
+  while (digits > 0 && ctx.digits[digits - 1] == 0) {
+    digits--;
+  }
+  *count = digits;
+  return ctx.digits;
+}